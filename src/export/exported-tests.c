@@ -55,6 +55,25 @@ sexp* rlang_test_lgl_which(sexp* x, sexp* na_true) {
 }
 
 
+// vec-chr.c
+
+sexp* rlang_test_chr_index(sexp* x, sexp* needles) {
+  struct r_chr_index* p_index = r_new_chr_index(x);
+  KEEP(p_index->shelter);
+
+  r_ssize n = r_length(needles);
+  sexp* out = KEEP(r_new_integer(n));
+  int* p_out = r_int_deref(out);
+
+  for (r_ssize i = 0; i < n; ++i) {
+    p_out[i] = r_chr_index_get(p_index, r_chr_get(needles, i)) + 1;
+  }
+
+  FREE(2);
+  return out;
+}
+
+
 // parse.c
 
 sexp* rlang_test_parse(sexp* str) {
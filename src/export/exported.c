@@ -283,13 +283,13 @@ sexp* rlang_env_inherits(sexp* env, sexp* ancestor) {
   return r_lgl(r_env_inherits(env, ancestor, r_empty_env));
 }
 
+// From internal/eval-tidy.c
+void rlang_data_pronoun_cache_invalidate(sexp* env);
+
 sexp* rlang_env_bind_list(sexp* env, sexp* names, sexp* data) {
   if (r_typeof(env) != r_type_environment) {
     r_abort("Internal error: `env` must be an environment.");
   }
-  if (r_typeof(names) != r_type_character) {
-    r_abort("Internal error: `names` must be a character vector.");
-  }
   if (r_typeof(data) != r_type_list) {
     r_abort("Internal error: `data` must be a list.");
   }
@@ -299,12 +299,33 @@ sexp* rlang_env_bind_list(sexp* env, sexp* names, sexp* data) {
     r_abort("Internal error: `data` and `names` must have the same length.");
   }
 
-  sexp* const * p_names = r_chr_deref_const(names);
+  switch (r_typeof(names)) {
+  case r_type_character: {
+    sexp* const * p_names = r_chr_deref_const(names);
+    for (r_ssize i = 0; i < n; ++i) {
+      Rf_defineVar(r_str_as_symbol(p_names[i]), r_list_get(data, i), env);
+    }
+    break;
+  }
 
-  for (r_ssize i = 0; i < n; ++i) {
-    Rf_defineVar(r_str_as_symbol(p_names[i]), r_list_get(data, i), env);
+  // Symbols interned once by the caller and reused across environments
+  case r_type_list: {
+    sexp* const * p_names = r_list_deref_const(names);
+    for (r_ssize i = 0; i < n; ++i) {
+      if (r_typeof(p_names[i]) != r_type_symbol) {
+        r_abort("Internal error: `names` must be a list of symbols.");
+      }
+      Rf_defineVar(p_names[i], r_list_get(data, i), env);
+    }
+    break;
   }
 
+  default:
+    r_abort("Internal error: `names` must be a character vector or a list of symbols.");
+  }
+
+  rlang_data_pronoun_cache_invalidate(env);
+
   return r_null;
 }
 
@@ -426,8 +447,7 @@ sexp* rlang_call_has_precedence(sexp* x, sexp* y, sexp* side) {
 }
 
 sexp* rlang_which_operator(sexp* call) {
-  const char* op = r_op_as_c_string(r_which_operator(call));
-  return r_chr(op);
+  return r_op_as_string(r_which_operator(call));
 }
 
 
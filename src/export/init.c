@@ -18,6 +18,7 @@ extern sexp* rlang_env_frame(sexp* env);
 extern sexp* rlang_env_hash_table(sexp* env);
 extern sexp* rlang_poke_type(sexp*, sexp*);
 extern sexp* rlang_replace_na(sexp*, sexp*);
+extern sexp* rlang_vec_constant(sexp*, sexp*);
 extern sexp* rlang_node_car(sexp*);
 extern sexp* rlang_node_cdr(sexp*);
 extern sexp* rlang_node_caar(sexp*);
@@ -51,6 +52,9 @@ extern sexp* rlang_squash(sexp*, sexp*, sexp*, sexp*);
 extern sexp* rlang_symbol(sexp*);
 extern sexp* rlang_sym_as_character(sexp*);
 extern sexp* rlang_tilde_eval(sexp*, sexp*, sexp*);
+extern sexp* rlang_trace_capture(sexp*, sexp*, sexp*, sexp*);
+extern sexp* rlang_trace_sample_start(sexp*, sexp*, sexp*);
+extern sexp* rlang_trace_sample_stop();
 extern sexp* rlang_unescape_character(sexp*);
 extern sexp* rlang_capturearginfo(sexp*, sexp*, sexp*, sexp*);
 extern sexp* rlang_capturedots(sexp*, sexp*, sexp*, sexp*);
@@ -88,6 +92,26 @@ extern sexp* rlang_quo_get_env(sexp*);
 extern sexp* rlang_quo_set_env(sexp*, sexp*);
 extern sexp* rlang_which_operator(sexp*);
 extern sexp* rlang_new_data_mask(sexp*, sexp*);
+extern sexp* rlang_eval_tidy_list(sexp*, sexp*, sexp*);
+extern sexp* rlang_expr_usage(sexp*);
+extern sexp* rlang_expr_template(sexp*);
+extern sexp* rlang_template_fill(sexp*, sexp*);
+extern sexp* rlang_new_lines_buffer(sexp*);
+extern sexp* rlang_lines_get(sexp*);
+extern sexp* rlang_lines_push(sexp*, sexp*, sexp*);
+extern sexp* rlang_lines_push_sticky(sexp*, sexp*, sexp*);
+extern sexp* rlang_lines_push_newline(sexp*);
+extern sexp* rlang_lines_make_next_sticky(sexp*);
+extern sexp* rlang_lines_set_boundary(sexp*);
+extern sexp* rlang_lines_increase_indent(sexp*);
+extern sexp* rlang_lines_decrease_indent(sexp*);
+extern sexp* rlang_line_push(sexp*, sexp*, sexp*, sexp*, sexp*, sexp*, sexp*);
+extern sexp* rlang_deparse(sexp*, sexp*, sexp*);
+extern sexp* rlang_needs_backticks(sexp*);
+extern sexp* rlang_eval_tidy_grouped(sexp*, sexp*, sexp*, sexp*);
+extern sexp* rlang_eval_tidy_cache_enable(sexp*);
+extern sexp* rlang_eval_tidy_cache_stats();
+extern sexp* rlang_eval_tidy_cache_reset();
 extern sexp* rlang_new_data_mask_compat(sexp*, sexp*, sexp*);
 extern sexp* rlang_as_data_mask(sexp*);
 extern sexp* rlang_as_data_mask_compat(sexp*, sexp*);
@@ -134,6 +158,7 @@ extern sexp* rlang_chr_get(sexp* x, sexp* i);
 extern sexp* rlang_env_has(sexp*, sexp*, sexp*);
 extern sexp* rlang_env_poke(sexp*, sexp*, sexp*, sexp*, sexp*);
 extern sexp* rlang_env_bind(sexp*, sexp*, sexp*, sexp*, sexp*);
+extern sexp* rlang_new_environment(sexp*, sexp*);
 extern sexp* rlang_raw_deparse_str(sexp*, sexp*, sexp*);
 extern sexp* rlang_env_browse(sexp*, sexp*);
 extern sexp* rlang_env_is_browsed(sexp*);
@@ -161,6 +186,7 @@ extern sexp* rlang_test_Rf_warningcall(sexp*, sexp*);
 extern sexp* rlang_test_Rf_errorcall(sexp*, sexp*);
 extern sexp* rlang_test_lgl_sum(sexp*, sexp*);
 extern sexp* rlang_test_lgl_which(sexp*, sexp*);
+extern sexp* rlang_test_chr_index(sexp*, sexp*);
 extern sexp* rlang_new_dict(sexp*, sexp*);
 extern sexp* rlang_dict_put(sexp*, sexp*, sexp*);
 extern sexp* rlang_dict_del(sexp*, sexp*);
@@ -188,6 +214,7 @@ static const R_CallMethodDef r_callables[] = {
   {"r_f_rhs",                           (DL_FUNC) &r_f_rhs, 1},
   {"rlang_new_condition",               (DL_FUNC) &r_new_condition, 3},
   {"rlang_replace_na",                  (DL_FUNC) &rlang_replace_na, 2},
+  {"rlang_vec_constant",                (DL_FUNC) &rlang_vec_constant, 2},
   {"rlang_capturearginfo",              (DL_FUNC) &rlang_capturearginfo, 4},
   {"rlang_capturedots",                 (DL_FUNC) &rlang_capturedots, 4},
   {"rlang_duplicate",                   (DL_FUNC) &rlang_duplicate, 2},
@@ -240,6 +267,9 @@ static const R_CallMethodDef r_callables[] = {
   // No longer necessary but keep this around for a while in case
   // quosures ended up saved as RDS.
   {"rlang_tilde_eval",                  (DL_FUNC) &rlang_tilde_eval, 3},
+  {"rlang_trace_capture",               (DL_FUNC) &rlang_trace_capture, 4},
+  {"rlang_trace_sample_start",          (DL_FUNC) &rlang_trace_sample_start, 3},
+  {"rlang_trace_sample_stop",           (DL_FUNC) &rlang_trace_sample_stop, 0},
   {"rlang_unescape_character",          (DL_FUNC) &rlang_unescape_character, 1},
   {"rlang_new_call",                    (DL_FUNC) &rlang_new_call_node, 2},
   {"rlang_cnd_signal",                  (DL_FUNC) &rlang_cnd_signal, 1},
@@ -259,6 +289,7 @@ static const R_CallMethodDef r_callables[] = {
   {"rlang_test_Rf_errorcall",           (DL_FUNC) &rlang_test_Rf_errorcall, 2},
   {"rlang_test_lgl_sum",                (DL_FUNC) &rlang_test_lgl_sum, 2},
   {"rlang_test_lgl_which",              (DL_FUNC) &rlang_test_lgl_which, 2},
+  {"rlang_test_chr_index",              (DL_FUNC) &rlang_test_chr_index, 2},
   {"rlang_r_string",                    (DL_FUNC) &rlang_r_string, 1},
   {"rlang_exprs_interp",                (DL_FUNC) &rlang_exprs_interp, 6},
   {"rlang_quos_interp",                 (DL_FUNC) &rlang_quos_interp, 6},
@@ -287,6 +318,26 @@ static const R_CallMethodDef r_callables[] = {
   {"rlang_which_operator",              (DL_FUNC) &rlang_which_operator, 1},
   {"rlang_call_has_precedence",         (DL_FUNC) &rlang_call_has_precedence, 3},
   {"rlang_new_data_mask",               (DL_FUNC) &rlang_new_data_mask, 2},
+  {"rlang_eval_tidy_list",              (DL_FUNC) &rlang_eval_tidy_list, 3},
+  {"rlang_expr_usage",                  (DL_FUNC) &rlang_expr_usage, 1},
+  {"rlang_expr_template",               (DL_FUNC) &rlang_expr_template, 1},
+  {"rlang_template_fill",               (DL_FUNC) &rlang_template_fill, 2},
+  {"rlang_new_lines_buffer",            (DL_FUNC) &rlang_new_lines_buffer, 1},
+  {"rlang_lines_get",                   (DL_FUNC) &rlang_lines_get, 1},
+  {"rlang_lines_push",                  (DL_FUNC) &rlang_lines_push, 3},
+  {"rlang_lines_push_sticky",           (DL_FUNC) &rlang_lines_push_sticky, 3},
+  {"rlang_lines_push_newline",          (DL_FUNC) &rlang_lines_push_newline, 1},
+  {"rlang_lines_make_next_sticky",      (DL_FUNC) &rlang_lines_make_next_sticky, 1},
+  {"rlang_lines_set_boundary",          (DL_FUNC) &rlang_lines_set_boundary, 1},
+  {"rlang_lines_increase_indent",       (DL_FUNC) &rlang_lines_increase_indent, 1},
+  {"rlang_lines_decrease_indent",       (DL_FUNC) &rlang_lines_decrease_indent, 1},
+  {"rlang_line_push",                   (DL_FUNC) &rlang_line_push, 7},
+  {"rlang_deparse",                     (DL_FUNC) &rlang_deparse, 3},
+  {"rlang_needs_backticks",             (DL_FUNC) &rlang_needs_backticks, 1},
+  {"rlang_eval_tidy_grouped",           (DL_FUNC) &rlang_eval_tidy_grouped, 4},
+  {"rlang_eval_tidy_cache_enable",      (DL_FUNC) &rlang_eval_tidy_cache_enable, 1},
+  {"rlang_eval_tidy_cache_stats",       (DL_FUNC) &rlang_eval_tidy_cache_stats, 0},
+  {"rlang_eval_tidy_cache_reset",       (DL_FUNC) &rlang_eval_tidy_cache_reset, 0},
   {"rlang_as_data_mask",                (DL_FUNC) &rlang_as_data_mask, 1},
   {"rlang_is_data_mask",                (DL_FUNC) &rlang_is_data_mask, 1},
   {"rlang_data_pronoun_get",            (DL_FUNC) &rlang_data_pronoun_get, 2},
@@ -330,6 +381,7 @@ static const R_CallMethodDef r_callables[] = {
   {"rlang_env_has",                     (DL_FUNC) &rlang_env_has, 3},
   {"rlang_env_poke",                    (DL_FUNC) &rlang_env_poke, 5},
   {"rlang_env_bind",                    (DL_FUNC) &rlang_env_bind, 5},
+  {"rlang_new_environment",             (DL_FUNC) &rlang_new_environment, 2},
   {"rlang_raw_deparse_str",             (DL_FUNC) &rlang_raw_deparse_str, 3},
   {"rlang_env_browse",                  (DL_FUNC) &rlang_env_browse, 2},
   {"rlang_env_is_browsed",              (DL_FUNC) &rlang_env_is_browsed, 1},
@@ -359,6 +411,7 @@ static const R_CallMethodDef r_callables[] = {
 };
 
 extern sexp* rlang_ext_arg_match0(sexp*);
+extern sexp* rlang_ext_arg_match_each(sexp*);
 extern sexp* rlang_ext_capturearginfo(sexp*);
 extern sexp* rlang_ext_capturedots(sexp*);
 extern sexp* rlang_ext_dots_values(sexp*);
@@ -372,6 +425,7 @@ extern sexp* rlang_ext2_tilde_eval(sexp*, sexp*, sexp*, sexp*);
 
 static const R_ExternalMethodDef externals[] = {
   {"rlang_ext_arg_match0",              (DL_FUNC) &rlang_ext_arg_match0, 3},
+  {"rlang_ext_arg_match_each",          (DL_FUNC) &rlang_ext_arg_match_each, 3},
   {"rlang_ext_capturearginfo",          (DL_FUNC) &rlang_ext_capturearginfo, 2},
   {"rlang_ext_capturedots",             (DL_FUNC) &rlang_ext_capturedots, 1},
   {"rlang_ext_dots_values",             (DL_FUNC) &rlang_ext_dots_values, 7},
@@ -391,6 +445,11 @@ extern sexp* rlang_env_dots_list(sexp*);
 extern sexp* rlang_eval_tidy(sexp*, sexp*, sexp*);
 extern void rlang_print_backtrace(bool full);
 
+// From internal/vec-view.c
+extern void rlang_init_vec_view(DllInfo* dll);
+// From internal/vec-constant.c
+extern void rlang_init_vec_constant(DllInfo* dll);
+
 // From xxhash.h
 extern uint64_t XXH3_64bits(const void*, size_t);
 
@@ -419,6 +478,11 @@ void R_init_rlang(DllInfo* dll) {
 
   // Experimental
   R_RegisterCCallable("rlang", "rlang_squash_if", (DL_FUNC) &r_squash_if);
+  R_RegisterCCallable("rlang", "rlang_eval_tidy_list", (DL_FUNC) &rlang_eval_tidy_list);
+  R_RegisterCCallable("rlang", "rlang_expr_usage", (DL_FUNC) &rlang_expr_usage);
+  R_RegisterCCallable("rlang", "rlang_expr_template", (DL_FUNC) &rlang_expr_template);
+  R_RegisterCCallable("rlang", "rlang_template_fill", (DL_FUNC) &rlang_template_fill);
+  R_RegisterCCallable("rlang", "rlang_eval_tidy_grouped", (DL_FUNC) &rlang_eval_tidy_grouped);
 
   // Compatibility
   R_RegisterCCallable("rlang", "rlang_as_data_mask", (DL_FUNC) &rlang_as_data_mask_compat);
@@ -427,6 +491,9 @@ void R_init_rlang(DllInfo* dll) {
   // Only for debugging - no stability guaranteed
   R_RegisterCCallable("rlang", "rlang_print_backtrace", (DL_FUNC) &rlang_print_backtrace);
 
+  rlang_init_vec_view(dll);
+  rlang_init_vec_constant(dll);
+
   R_registerRoutines(dll, NULL, r_callables, NULL, externals);
   R_useDynamicSymbols(dll, FALSE);
 }
@@ -440,6 +507,10 @@ sexp* rlang_library_load(sexp* ns) {
   return r_null;
 }
 
+// From "../internal/trace.c"
+void rlang_unload_trace();
+
 sexp* rlang_library_unload() {
+  rlang_unload_trace();
   return r_null;
 }
@@ -0,0 +1,18 @@
+#ifndef RLANG_INTERNAL_ALTREP_H
+#define RLANG_INTERNAL_ALTREP_H
+
+#include <Rversion.h>
+
+// ALTREP classes for all atomic types are available since R 3.6.0
+#if (R_VERSION >= R_Version(3, 6, 0))
+# define RLANG_HAS_ALTREP 1
+#else
+# define RLANG_HAS_ALTREP 0
+#endif
+
+#if RLANG_HAS_ALTREP
+# include <R_ext/Altrep.h>
+#endif
+
+
+#endif
@@ -26,9 +26,12 @@ sexp* capture(sexp* sym, sexp* frame, sexp** arg_env) {
   sexp* env = r_list_get(arg_info, 1);
 
   // Unquoting rearranges the expression
-  // FIXME: Only duplicate the call tree, not the leaves
-  expr = KEEP(r_copy(expr));
-  expr = call_interp(expr, env);
+  if (call_needs_interp(expr)) {
+    expr = KEEP(call_tree_copy(expr));
+    expr = call_interp(expr, env);
+  } else {
+    KEEP(expr);
+  }
 
   if (arg_env) {
     *arg_env = env;
@@ -76,9 +79,68 @@ sexp* rlang_enquo(sexp* sym, sexp* frame) {
 }
 
 static sexp* stop_arg_match_call = NULL;
+static sexp* stop_arg_match_each_call = NULL;
 static sexp* arg_nm_sym = NULL;
 void arg_match0_abort(const char* msg, sexp* env);
 
+
+/**
+ * Strings are matched against `values` with the rules of
+ * `r_chr_index_get()`, by pointer or by UTF-8 translation. Vectors
+ * of 16 or more values are searched through an index, shorter ones
+ * linearly with `r_chr_find()`.
+ *
+ * Indices are cached so that validating against the same vocabulary
+ * repeatedly doesn't rebuild them. Cache entries are identified by
+ * the address of `values`. R only supports weak references to
+ * environments and external pointers, so the cache keeps its vectors
+ * alive instead. This prevents the address from being reused by
+ * another vector. Only vectors that are already shared are cached
+ * since others could be modified in place behind the index. These
+ * are searched linearly. Entries are evicted in round-robin order.
+ */
+#define ARG_INDEX_MIN_SIZE 16
+#define ARG_INDEX_CACHE_SIZE 8
+
+static sexp* arg_index_cache = NULL;
+static r_ssize arg_index_cache_next = 0;
+
+// Returns `NULL` when `values` should be searched linearly. The index
+// is protected by the cache.
+static
+struct r_chr_index* arg_values_index(sexp* values) {
+  if (r_length(values) < ARG_INDEX_MIN_SIZE || !r_is_shared(values)) {
+    return NULL;
+  }
+
+  sexp* const * p_cache = r_list_deref_const(arg_index_cache);
+
+  for (r_ssize i = 0; i < ARG_INDEX_CACHE_SIZE; ++i) {
+    sexp* shelter = p_cache[i];
+    if (shelter != r_null && r_list_get(shelter, 2) == values) {
+      return r_raw_deref(r_list_get(shelter, 0));
+    }
+  }
+
+  struct r_chr_index* p_index = r_new_chr_index(values);
+
+  r_list_poke(arg_index_cache, arg_index_cache_next, p_index->shelter);
+  arg_index_cache_next = (arg_index_cache_next + 1) % ARG_INDEX_CACHE_SIZE;
+
+  return p_index;
+}
+
+// Returns the position of the first occurrence of `str` in `values`
+// or -1
+static inline
+r_ssize arg_values_find(sexp* values, struct r_chr_index* p_index, sexp* str) {
+  if (p_index) {
+    return r_chr_index_get(p_index, str);
+  } else {
+    return r_chr_find(values, str);
+  }
+}
+
 sexp* rlang_ext_arg_match0(sexp* args) {
   args = r_node_cdr(args);
 
@@ -104,11 +166,9 @@ sexp* rlang_ext_arg_match0(sexp* args) {
 
   // Simple case: one argument, we check if it's one of the values.
   if (arg_len == 1) {
-    sexp* arg_char = r_chr_get(arg, 0);
-    for (r_ssize i = 0; i < values_len; ++i) {
-      if (arg_char == r_chr_get(values, i)) {
-        return(arg);
-      }
+    struct r_chr_index* p_index = arg_values_index(values);
+    if (arg_values_find(values, p_index, r_chr_get(arg, 0)) >= 0) {
+      return(arg);
     }
 
     sexp* arg_nm = KEEP(r_eval(arg_nm_sym, env));
@@ -133,40 +193,79 @@ sexp* rlang_ext_arg_match0(sexp* args) {
     return(r_str_as_character(p_arg[0]));
   }
 
-  sexp* my_values = KEEP(r_clone(values));
-  sexp* const * p_my_values = r_chr_deref_const(my_values);
+  // Count the occurrences of each value at the position of its first
+  // occurrence, then consume them while matching `arg`
+  struct r_chr_index* p_index = arg_values_index(values);
 
-  // Invariant: my_values[i:(len-1)] contains the values we haven't matched yet
-  for (; i < arg_len; ++i) {
-    sexp* current_arg = p_arg[i];
-    if (current_arg == p_my_values[i]) {
-      continue;
-    }
+  sexp* counts = KEEP(r_new_integer(values_len));
+  int* p_counts = r_int_deref(counts);
+  memset(p_counts, 0, values_len * sizeof(int));
 
-    bool matched = false;
-    for (r_ssize j = i + 1; j < arg_len; ++j) {
-      if (current_arg == p_my_values[j]) {
-        matched = true;
+  for (r_ssize j = i; j < values_len; ++j) {
+    ++p_counts[arg_values_find(values, p_index, p_values[j])];
+  }
 
-        // Replace matched value by the element that failed to match at this iteration
-        r_chr_poke(my_values, j, p_my_values[i]);
-        break;
-      }
-    }
+  for (; i < arg_len; ++i) {
+    r_ssize j = arg_values_find(values, p_index, p_arg[i]);
 
-    if (!matched) {
+    if (j < 0 || p_counts[j] == 0) {
       arg = KEEP(r_str_as_character(r_chr_get(arg, 0)));
       sexp* arg_nm = KEEP(r_eval(arg_nm_sym, env));
       r_eval_with_xyz(stop_arg_match_call, arg, values, arg_nm, rlang_ns_env);
 
       r_stop_unreached("rlang_ext2_arg_match0");
     }
+
+    --p_counts[j];
   }
 
   FREE(1);
   return(r_str_as_character(r_chr_get(arg, 0)));
 }
 
+sexp* rlang_ext_arg_match_each(sexp* args) {
+  args = r_node_cdr(args);
+
+  sexp* arg = r_node_car(args); args = r_node_cdr(args);
+  sexp* values = r_node_car(args); args = r_node_cdr(args);
+  sexp* env = r_node_car(args);
+
+  if (r_typeof(arg) != r_type_character) {
+    arg_match0_abort("`%s` must be a character vector.", env);
+  }
+  if (r_typeof(values) != r_type_character) {
+    r_abort("`values` must be a character vector.");
+  }
+  if (r_length(values) == 0) {
+    arg_match0_abort("`values` must have at least one element.", env);
+  }
+
+  r_ssize n = r_length(arg);
+  sexp* const * p_arg = r_chr_deref_const(arg);
+
+  struct r_dyn_array* p_invalid = r_new_dyn_vector(r_type_integer, 8);
+  KEEP(p_invalid->shelter);
+
+  struct r_chr_index* p_index = arg_values_index(values);
+
+  for (r_ssize i = 0; i < n; ++i) {
+    if (arg_values_find(values, p_index, p_arg[i]) < 0) {
+      r_int_push_back(p_invalid, i + 1);
+    }
+  }
+
+  if (p_invalid->count) {
+    sexp* invalid = KEEP(r_arr_unwrap(p_invalid));
+    sexp* arg_nm = KEEP(r_eval(arg_nm_sym, env));
+    r_eval_with_wxyz(stop_arg_match_each_call, arg, values, arg_nm, invalid, rlang_ns_env);
+
+    r_stop_unreached("rlang_ext_arg_match_each");
+  }
+
+  FREE(1);
+  return arg;
+}
+
 void arg_match0_abort(const char* msg, sexp* env) {
   sexp* arg_nm = KEEP(r_eval(arg_nm_sym, env));
 
@@ -182,5 +281,11 @@ void rlang_init_arg(sexp* ns) {
   stop_arg_match_call = r_parse("stop_arg_match(x, y, z)");
   r_preserve(stop_arg_match_call);
 
+  stop_arg_match_each_call = r_parse("stop_arg_match_each(w, x, y, z)");
+  r_preserve(stop_arg_match_each_call);
+
+  arg_index_cache = r_new_list(ARG_INDEX_CACHE_SIZE);
+  r_preserve(arg_index_cache);
+
   arg_nm_sym = r_sym("arg_nm");
 }
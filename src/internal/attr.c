@@ -1,6 +1,7 @@
 #include <rlang.h>
 #include "internal.h"
 #include "vec.h"
+#include "vec-constant.h"
 
 static sexp* c_fn = NULL;
 static sexp* as_character_call = NULL;
@@ -35,8 +36,7 @@ sexp* rlang_names2(sexp* x, sexp* env) {
 
   if (nms == r_null) {
     r_ssize n = r_length(x);
-    nms = KEEP(r_new_vector(r_type_character, n));
-    r_chr_fill(nms, r_strs_empty);
+    nms = KEEP(r_vec_constant(r_chrs_empty_string, n));
   } else {
     nms = KEEP(rlang_replace_na(nms, r_chrs_empty_string));
   }
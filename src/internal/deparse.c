@@ -0,0 +1,1348 @@
+#include <rlang.h>
+#include "internal.h"
+#include "parse.h"
+#include "quo.h"
+#include "utils.h"
+
+/**
+ * Line buffer of the deparser. The node deparsers at the end of this
+ * file walk the expression and push tokens. The buffer breaks lines
+ * when they overflow the width, keeps track of sticky tokens and
+ * boundaries, and manages the indentation status of openers.
+ *
+ * The last line is a growable UTF-8 byte buffer so that pushing a
+ * token appends in place. A CHARSXP is only created once a line is
+ * complete. Widths are counted in characters, like `nchar()`, with
+ * ANSI escapes skipped when the output is coloured.
+ */
+
+struct indent_status {
+  bool reset;
+  int n_sticky;
+};
+
+struct lines_info {
+  double width;
+  r_ssize boundary;
+  bool next_sticky;
+  int indent;
+  bool next_indent_sticky;
+
+  // The last line may be missing, e.g. before the first push
+  bool has_last;
+
+  struct r_dyn_array* p_lines;
+  struct r_dyn_array* p_last;
+  struct r_dyn_array* p_scratch;
+  struct r_dyn_array* p_status;
+};
+
+#define LINES_N 5
+#define LINES_INFO 0
+#define LINES_LINES 1
+#define LINES_LAST 2
+#define LINES_SCRATCH 3
+#define LINES_STATUS 4
+
+#define NO_BOUNDARY -1
+
+
+static
+sexp* new_lines_buffer(double width) {
+  sexp* out = KEEP(r_new_list(LINES_N));
+
+  sexp* info = r_new_raw(sizeof(struct lines_info));
+  r_list_poke(out, LINES_INFO, info);
+
+  struct lines_info* p_info = r_raw_deref(info);
+  p_info->width = width;
+  p_info->boundary = NO_BOUNDARY;
+  p_info->next_sticky = false;
+  p_info->indent = 0;
+  p_info->next_indent_sticky = false;
+  p_info->has_last = false;
+
+  p_info->p_lines = r_new_dyn_vector(r_type_character, 8);
+  r_list_poke(out, LINES_LINES, p_info->p_lines->shelter);
+
+  p_info->p_last = r_new_dyn_array(1, 128);
+  r_list_poke(out, LINES_LAST, p_info->p_last->shelter);
+
+  p_info->p_scratch = r_new_dyn_array(1, 128);
+  r_list_poke(out, LINES_SCRATCH, p_info->p_scratch->shelter);
+
+  p_info->p_status = r_new_dyn_array(sizeof(struct indent_status), 8);
+  r_list_poke(out, LINES_STATUS, p_info->p_status->shelter);
+
+  FREE(1);
+  return out;
+}
+
+static
+struct lines_info* lines_deref(sexp* x) {
+  if (r_typeof(x) != r_type_list || r_length(x) != LINES_N) {
+    r_abort("Internal error: Expected a lines buffer.");
+  }
+  return r_raw_deref(r_list_get(x, LINES_INFO));
+}
+
+
+static inline
+void bytes_reserve(struct r_dyn_array* p_buf, r_ssize n) {
+  r_ssize needed = p_buf->count + n;
+  if (needed <= p_buf->capacity) {
+    return;
+  }
+
+  r_ssize capacity = p_buf->capacity;
+  while (capacity < needed) {
+    capacity = r_ssize_mult(capacity, p_buf->growth_factor);
+  }
+  r_arr_resize(p_buf, capacity);
+}
+
+static
+void bytes_push(struct r_dyn_array* p_buf, const char* src, r_ssize n) {
+  if (n <= 0) {
+    return;
+  }
+  bytes_reserve(p_buf, n);
+  memcpy((char*) r_arr_ptr_end(p_buf), src, n);
+  p_buf->count += n;
+}
+
+static
+void bytes_push_spaces(struct r_dyn_array* p_buf, int n) {
+  if (n <= 0) {
+    return;
+  }
+  bytes_reserve(p_buf, n);
+  memset(r_arr_ptr_end(p_buf), ' ', n);
+  p_buf->count += n;
+}
+
+static inline
+const char* bytes_ptr(struct r_dyn_array* p_buf) {
+  return (const char*) r_arr_ptr_const_front(p_buf);
+}
+
+
+// Length of the ANSI escape at the start of `s`, or 0. Equivalent to
+// matching `ansi_regex` (see `strip_style()`) at this position.
+static
+r_ssize ansi_match(const unsigned char* s, r_ssize n) {
+  r_ssize i;
+
+  if (s[0] == 0x1b && n > 1) {
+    if (s[1] != '[') {
+      return ('A' <= s[1] && s[1] <= 'M') ? 2 : 0;
+    }
+    i = 2;
+  } else if (s[0] == 0xc2 && n > 1 && s[1] == 0x9b) {
+    i = 2;
+  } else {
+    return 0;
+  }
+
+  // The terminator can't be a digit or a semicolon so a greedy scan
+  // never needs to backtrack
+  for (int j = 0; j < 3 && i < n && '0' <= s[i] && s[i] <= '9'; ++j) {
+    ++i;
+  }
+  while (i < n && s[i] == ';') {
+    ++i;
+    for (int j = 0; j < 3 && i < n && '0' <= s[i] && s[i] <= '9'; ++j) {
+      ++i;
+    }
+  }
+
+  if (i == n) {
+    return 0;
+  }
+
+  unsigned char c = s[i];
+  if (('A' <= c && c <= 'M') || ('f' <= c && c <= 'm') || c == '|') {
+    return i + 1;
+  } else {
+    return 0;
+  }
+}
+
+static inline
+bool is_utf8_lead(unsigned char c) {
+  return (c & 0xc0) != 0x80;
+}
+
+// Number of characters, i.e. `nchar(type = "chars")`
+static
+r_ssize str_nchar(const char* s, r_ssize n) {
+  r_ssize out = 0;
+  for (r_ssize i = 0; i < n; ++i) {
+    out += is_utf8_lead(s[i]);
+  }
+  return out;
+}
+
+// Byte offset of the `n_chars`th character
+static
+r_ssize str_char_offset(const char* s, r_ssize n, r_ssize n_chars) {
+  r_ssize i = 0;
+  for (; i < n; ++i) {
+    if (is_utf8_lead(s[i]) && n_chars-- == 0) {
+      break;
+    }
+  }
+  return i;
+}
+
+struct str_width {
+  r_ssize width;
+  r_ssize trimmed_width;
+  bool is_spaces;
+};
+
+static
+struct str_width str_width(const char* str, r_ssize n, bool has_colour) {
+  const unsigned char* s = (const unsigned char*) str;
+  struct str_width out = { .width = 0, .trimmed_width = 0, .is_spaces = true };
+
+  r_ssize i = 0;
+  while (i < n) {
+    if (has_colour) {
+      r_ssize skip = ansi_match(s + i, n - i);
+      if (skip) {
+        i += skip;
+        continue;
+      }
+    }
+
+    if (is_utf8_lead(s[i])) {
+      ++out.width;
+      if (s[i] != ' ') {
+        out.is_spaces = false;
+        out.trimmed_width = out.width;
+      }
+    }
+    ++i;
+  }
+
+  return out;
+}
+
+static
+bool has_overflown(const char* line, r_ssize n_line,
+                   const char* text, r_ssize n_text,
+                   double width,
+                   bool has_colour) {
+  struct str_width line_width = str_width(line, n_line, has_colour);
+  if (line_width.is_spaces) {
+    return false;
+  }
+
+  struct str_width text_width = str_width(text, n_text, has_colour);
+  return line_width.width + text_width.trimmed_width > width;
+}
+
+static inline
+r_ssize trim_trailing_spaces(const char* s, r_ssize n) {
+  while (n && s[n - 1] == ' ') {
+    --n;
+  }
+  return n;
+}
+
+static
+void lines_push_line(struct lines_info* p_info, const char* s, r_ssize n) {
+  sexp* line = KEEP(Rf_mkCharLenCE(s, n, CE_UTF8));
+  r_arr_push_back(p_info->p_lines, line);
+  FREE(1);
+}
+
+static
+void lines_swap_last(struct lines_info* p_info) {
+  struct r_dyn_array* p_last = p_info->p_last;
+  p_info->p_last = p_info->p_scratch;
+  p_info->p_scratch = p_last;
+}
+
+static
+int lines_indent(struct lines_info* p_info) {
+  if (p_info->indent < 0) {
+    r_warn("Internal error: Negative indent while deparsing");
+    return 0;
+  } else {
+    return p_info->indent;
+  }
+}
+
+// Pushes `text` on the last line, or on a new line if it overflows
+// the width. Returns whether a new line was started.
+static
+bool line_push(struct lines_info* p_info,
+               const char* text,
+               r_ssize n_text,
+               bool has_colour) {
+  struct r_dyn_array* p_last = p_info->p_last;
+
+  if (!p_info->has_last) {
+    p_last->count = 0;
+    bytes_push(p_last, text, n_text);
+    p_info->has_last = true;
+    return false;
+  }
+
+  const char* line = bytes_ptr(p_last);
+  r_ssize n_line = p_last->count;
+
+  if (!has_overflown(line, n_line, text, n_text, p_info->width, has_colour)) {
+    bytes_push(p_last, text, n_text);
+    return false;
+  }
+
+  int indent = lines_indent(p_info);
+  r_ssize boundary = p_info->boundary;
+  bool sticky = p_info->next_sticky;
+
+  struct r_dyn_array* p_scratch = p_info->p_scratch;
+  p_scratch->count = 0;
+
+  if (boundary != NO_BOUNDARY && str_nchar(line, n_line) != boundary) {
+    r_ssize n_first = str_char_offset(line, n_line, boundary);
+
+    // Trim leading spaces after boundary
+    r_ssize second_start = n_first;
+    while (second_start < n_line && line[second_start] == ' ') {
+      ++second_start;
+    }
+
+    bytes_push_spaces(p_scratch, indent);
+    bytes_push(p_scratch, line + second_start, n_line - second_start);
+
+    const char* second = bytes_ptr(p_scratch);
+    r_ssize n_second = p_scratch->count;
+
+    if (sticky || !has_overflown(second, n_second, text, n_text, p_info->width, has_colour)) {
+      lines_push_line(p_info, line, trim_trailing_spaces(line, n_first));
+      bytes_push(p_scratch, text, n_text);
+    } else {
+      lines_push_line(p_info, line, n_line);
+      p_scratch->count = 0;
+      bytes_push_spaces(p_scratch, indent);
+      bytes_push(p_scratch, text, n_text);
+    }
+  } else if (sticky) {
+    bytes_push(p_last, text, n_text);
+    return false;
+  } else {
+    lines_push_line(p_info, line, trim_trailing_spaces(line, n_line));
+    bytes_push_spaces(p_scratch, indent);
+    bytes_push(p_scratch, text, n_text);
+  }
+
+  lines_swap_last(p_info);
+  return true;
+}
+
+static
+void lines_push_text(struct lines_info* p_info,
+                     const char* text,
+                     r_ssize n_text,
+                     bool has_colour) {
+  if (line_push(p_info, text, n_text, has_colour)) {
+    p_info->boundary = NO_BOUNDARY;
+    p_info->next_indent_sticky = false;
+  } else if (p_info->next_sticky) {
+    struct r_dyn_array* p_last = p_info->p_last;
+    p_info->boundary = str_nchar(bytes_ptr(p_last), p_last->count);
+  }
+
+  p_info->next_sticky = false;
+}
+
+static
+void lines_push(struct lines_info* p_info, sexp* lines, bool has_colour) {
+  if (r_typeof(lines) != r_type_character) {
+    r_abort("`lines` must be a character vector.");
+  }
+
+  r_ssize n = r_length(lines);
+  sexp* const * v_lines = r_chr_deref_const(lines);
+
+  for (r_ssize i = 0; i < n; ++i) {
+    const char* text = Rf_translateCharUTF8(v_lines[i]);
+    lines_push_text(p_info, text, strlen(text), has_colour);
+  }
+}
+
+static
+void lines_set_boundary(struct lines_info* p_info) {
+  if (p_info->has_last) {
+    struct r_dyn_array* p_last = p_info->p_last;
+    p_info->boundary = str_nchar(bytes_ptr(p_last), p_last->count);
+  } else {
+    p_info->boundary = NO_BOUNDARY;
+  }
+}
+
+static
+void lines_push_sticky_text(struct lines_info* p_info,
+                            const char* text,
+                            r_ssize n_text,
+                            bool has_colour) {
+  p_info->next_sticky = true;
+  lines_push_text(p_info, text, n_text, has_colour);
+  lines_set_boundary(p_info);
+}
+
+static
+void lines_push_newline(struct lines_info* p_info) {
+  if (p_info->has_last) {
+    struct r_dyn_array* p_last = p_info->p_last;
+    lines_push_line(p_info, bytes_ptr(p_last), p_last->count);
+  }
+
+  p_info->p_last->count = 0;
+  bytes_push_spaces(p_info->p_last, lines_indent(p_info));
+  p_info->has_last = true;
+
+  p_info->next_sticky = false;
+  p_info->next_indent_sticky = false;
+}
+
+static
+void lines_increase_indent(struct lines_info* p_info) {
+  struct r_dyn_array* p_status = p_info->p_status;
+
+  if (p_info->next_indent_sticky) {
+    if (p_status->count) {
+      struct indent_status* p_top = r_arr_ptr_back(p_status);
+      ++p_top->n_sticky;
+    }
+  } else {
+    p_info->indent += 2;
+
+    struct indent_status status = { .reset = false, .n_sticky = 0 };
+    r_arr_push_back(p_status, &status);
+
+    p_info->next_indent_sticky = true;
+  }
+}
+
+static
+void lines_decrease_indent(struct lines_info* p_info) {
+  struct r_dyn_array* p_status = p_info->p_status;
+
+  if (!p_status->count) {
+    r_warn("Internal error: Detected NULL `status` while deparsing");
+    return;
+  }
+
+  struct indent_status* p_top = r_arr_ptr_back(p_status);
+
+  // Decrease indent level only once for all the openers that were
+  // on a single line
+  if (!p_top->reset) {
+    p_info->indent -= 2;
+    p_top->reset = true;
+    p_info->next_indent_sticky = false;
+  }
+
+  if (p_top->n_sticky >= 1) {
+    --p_top->n_sticky;
+  } else {
+    r_arr_pop_back(p_status);
+    p_info->next_indent_sticky = false;
+  }
+}
+
+static
+sexp* lines_get(struct lines_info* p_info) {
+  struct r_dyn_array* p_lines = p_info->p_lines;
+  r_ssize n = p_lines->count;
+
+  sexp* out = KEEP(r_new_character(n + p_info->has_last));
+  r_vec_poke_n(out, 0, p_lines->data, 0, n);
+
+  if (p_info->has_last) {
+    struct r_dyn_array* p_last = p_info->p_last;
+    r_chr_poke(out, n, Rf_mkCharLenCE(bytes_ptr(p_last), p_last->count, CE_UTF8));
+  }
+
+  FREE(1);
+  return out;
+}
+
+
+sexp* rlang_new_lines_buffer(sexp* width) {
+  return new_lines_buffer(r_dbl_get(width, 0));
+}
+
+sexp* rlang_lines_get(sexp* x) {
+  return lines_get(lines_deref(x));
+}
+
+sexp* rlang_lines_push(sexp* x, sexp* lines, sexp* has_colour) {
+  lines_push(lines_deref(x), lines, r_as_bool(has_colour));
+  return r_null;
+}
+
+sexp* rlang_lines_push_sticky(sexp* x, sexp* line, sexp* has_colour) {
+  if (!r_is_string(line)) {
+    r_abort("`line` must be a string.");
+  }
+  const char* text = Rf_translateCharUTF8(r_chr_get(line, 0));
+  lines_push_sticky_text(lines_deref(x), text, strlen(text), r_as_bool(has_colour));
+  return r_null;
+}
+
+sexp* rlang_lines_push_newline(sexp* x) {
+  lines_push_newline(lines_deref(x));
+  return r_null;
+}
+
+sexp* rlang_lines_make_next_sticky(sexp* x) {
+  lines_deref(x)->next_sticky = true;
+  return r_null;
+}
+
+sexp* rlang_lines_set_boundary(sexp* x) {
+  lines_set_boundary(lines_deref(x));
+  return r_null;
+}
+
+sexp* rlang_lines_increase_indent(sexp* x) {
+  lines_increase_indent(lines_deref(x));
+  return r_null;
+}
+
+sexp* rlang_lines_decrease_indent(sexp* x) {
+  lines_decrease_indent(lines_deref(x));
+  return r_null;
+}
+
+// Pushes `text` on `line` in a temporary buffer. Returns a character
+// vector of size 1 if `text` fits on the line, 2 otherwise.
+sexp* rlang_line_push(sexp* line,
+                      sexp* text,
+                      sexp* sticky,
+                      sexp* boundary,
+                      sexp* width,
+                      sexp* indent,
+                      sexp* has_colour) {
+  sexp* buf = KEEP(new_lines_buffer(r_dbl_get(width, 0)));
+  struct lines_info* p_info = lines_deref(buf);
+
+  lines_push(p_info, line, false);
+  p_info->next_sticky = r_as_bool(sticky);
+  p_info->boundary = r_int_get(boundary, 0);
+  p_info->indent = r_int_get(indent, 0);
+
+  const char* c_text = Rf_translateCharUTF8(r_chr_get(text, 0));
+  line_push(p_info, c_text, strlen(c_text), r_as_bool(has_colour));
+
+  sexp* out = lines_get(p_info);
+
+  FREE(1);
+  return out;
+}
+
+
+// Node deparsers. Each node pushes its tokens on the line buffer of
+// a `new_lines()` object. Atoms and objects are formatted by calling
+// back into R since their representation follows `deparse()` and
+// `rlang_type_sum()`. Quosures are passed to the `deparser` of the
+// lines object when it has one, which is how `quo_deparse()`
+// colours them.
+
+struct deparser {
+  struct lines_info* p_info;
+  bool has_colour;
+  sexp* lines;
+  sexp* quo_deparser;
+  struct r_dyn_array* p_text;
+};
+
+static sexp* deparse_buffer_sym = NULL;
+static sexp* deparse_has_colour_sym = NULL;
+static sexp* deparse_deparser_sym = NULL;
+
+static sexp* deparse_call = NULL;
+static sexp* deparse_keep_integer_call = NULL;
+static sexp* type_sum_call = NULL;
+static sexp* atom_elements_call = NULL;
+static sexp* quo_deparser_call = NULL;
+
+// From sym-unescape.c
+sexp* str_unserialise_unicode(sexp* r_string);
+
+// From rlang/vec.c
+void r_vec_poke_n(sexp* x, r_ssize offset,
+                  sexp* y, r_ssize from, r_ssize n);
+
+static void node_deparse(struct deparser* p, sexp* x);
+static void sexp_deparse(struct deparser* p, sexp* x);
+static void call_deparse(struct deparser* p, sexp* x);
+
+
+static inline
+void push(struct deparser* p, const char* text) {
+  lines_push_text(p->p_info, text, strlen(text), p->has_colour);
+}
+static inline
+void push_sticky(struct deparser* p, const char* text) {
+  lines_push_sticky_text(p->p_info, text, strlen(text), p->has_colour);
+}
+static inline
+void push_lines(struct deparser* p, sexp* lines) {
+  lines_push(p->p_info, lines, p->has_colour);
+}
+static inline
+void make_next_sticky(struct deparser* p) {
+  p->p_info->next_sticky = true;
+}
+
+// Pushes the concatenation of `prefix`, `str`, and `suffix`
+static
+void push_wrapped(struct deparser* p,
+                  const char* prefix,
+                  sexp* str,
+                  const char* suffix) {
+  struct r_dyn_array* p_text = p->p_text;
+  p_text->count = 0;
+
+  const char* c_str = Rf_translateCharUTF8(str);
+  bytes_push(p_text, prefix, strlen(prefix));
+  bytes_push(p_text, c_str, strlen(c_str));
+  bytes_push(p_text, suffix, strlen(suffix));
+
+  lines_push_text(p->p_info, bytes_ptr(p_text), p_text->count, p->has_colour);
+}
+
+
+static const char* reserved_words[] = {
+  "NULL", "NA", "TRUE", "FALSE", "Inf", "NaN", "NA_integer_",
+  "NA_real_", "NA_character_", "NA_complex_", "function", "while",
+  "repeat", "for", "if", "in", "else", "next", "break"
+};
+
+// Bytes of multibyte characters are treated as letters, like
+// `[[:alpha:]]` does in UTF-8 locales
+static inline
+bool is_name_start(unsigned char c) {
+  return
+    ('a' <= c && c <= 'z') ||
+    ('A' <= c && c <= 'Z') ||
+    c == '.' ||
+    c >= 0x80;
+}
+static inline
+bool is_digit(unsigned char c) {
+  return '0' <= c && c <= '9';
+}
+static inline
+bool is_name_char(unsigned char c) {
+  return is_name_start(c) || is_digit(c) || c == '_';
+}
+
+static
+bool needs_backticks(const char* str) {
+  const unsigned char* s = (const unsigned char*) str;
+  if (!s[0]) {
+    return false;
+  }
+
+  for (size_t i = 0; i < R_ARR_SIZEOF(reserved_words); ++i) {
+    if (strcmp(str, reserved_words[i]) == 0) {
+      return true;
+    }
+  }
+
+  if (!is_name_start(s[0])) {
+    return true;
+  }
+
+  // `.0` double literals
+  if (s[0] == '.' && is_digit(s[1])) {
+    return true;
+  }
+
+  for (const unsigned char* c = s + 1; *c; ++c) {
+    if (!is_name_char(*c)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+sexp* rlang_needs_backticks(sexp* str) {
+  if (!r_is_string(str)) {
+    r_stop_internal("rlang_needs_backticks", "`str` must be a string.");
+  }
+  return r_lgl(needs_backticks(Rf_translateCharUTF8(r_chr_get(str, 0))));
+}
+
+
+static
+void sym_deparse(struct deparser* p, sexp* x) {
+  sexp* str = KEEP(str_unserialise_unicode(PRINTNAME(x)));
+
+  if (needs_backticks(Rf_translateCharUTF8(str))) {
+    push_wrapped(p, "`", str, "`");
+  } else {
+    push_wrapped(p, "", str, "");
+  }
+
+  FREE(1);
+}
+
+static
+void fmls_deparse(struct deparser* p, sexp* x) {
+  push_sticky(p, "(");
+  lines_increase_indent(p->p_info);
+
+  while (x != r_null) {
+    sym_deparse(p, r_node_tag(x));
+
+    sexp* car = r_node_car(x);
+    if (car != r_syms_missing) {
+      push_sticky(p, " = ");
+      make_next_sticky(p);
+      node_deparse(p, car);
+    }
+
+    x = r_node_cdr(x);
+    if (x != r_null) {
+      push_sticky(p, ", ");
+    }
+  }
+
+  push_sticky(p, ")");
+  lines_decrease_indent(p->p_info);
+}
+
+static
+void fn_call_deparse(struct deparser* p, sexp* x) {
+  push(p, "function");
+
+  x = r_node_cdr(x);
+  fmls_deparse(p, r_node_car(x));
+
+  push_sticky(p, " ");
+  lines_increase_indent(p->p_info);
+
+  x = r_node_cdr(x);
+  node_deparse(p, r_node_car(x));
+  lines_decrease_indent(p->p_info);
+}
+
+static
+void fn_deparse(struct deparser* p, sexp* x) {
+  push(p, "<function");
+
+  fmls_deparse(p, FORMALS(x));
+
+  push_sticky(p, " ");
+  lines_increase_indent(p->p_info);
+
+  node_deparse(p, r_fn_body(x));
+  push_sticky(p, ">");
+  lines_decrease_indent(p->p_info);
+}
+
+static
+void while_deparse(struct deparser* p, sexp* x) {
+  x = r_node_cdr(x);
+  push(p, "while (");
+  node_deparse(p, r_node_car(x));
+
+  x = r_node_cdr(x);
+  push(p, ") ");
+  node_deparse(p, r_node_car(x));
+}
+static
+void for_deparse(struct deparser* p, sexp* x) {
+  x = r_node_cdr(x);
+  push(p, "for (");
+  node_deparse(p, r_node_car(x));
+
+  x = r_node_cdr(x);
+  push(p, " in ");
+  node_deparse(p, r_node_car(x));
+
+  x = r_node_cdr(x);
+  push(p, ") ");
+  node_deparse(p, r_node_car(x));
+}
+static
+void repeat_deparse(struct deparser* p, sexp* x) {
+  push(p, "repeat ");
+  node_deparse(p, r_node_cadr(x));
+}
+static
+void if_deparse(struct deparser* p, sexp* x) {
+  x = r_node_cdr(x);
+  push(p, "if (");
+  node_deparse(p, r_node_car(x));
+
+  x = r_node_cdr(x);
+  push(p, ") ");
+  node_deparse(p, r_node_car(x));
+
+  x = r_node_cdr(x);
+  if (x != r_null) {
+    push(p, " else ");
+    node_deparse(p, r_node_car(x));
+  }
+}
+
+// Wrap if the call lower in the AST is not supposed to have
+// precedence. This sort of AST cannot arise in parsed code but can
+// occur in constructed calls.
+static
+void operand_deparse(struct deparser* p, sexp* x, sexp* parent, bool lhs) {
+  bool wrap = lhs ?
+    !r_lhs_call_has_precedence(x, parent) :
+    !r_rhs_call_has_precedence(x, parent);
+
+  if (wrap) {
+    push(p, "(");
+    make_next_sticky(p);
+  }
+
+  node_deparse(p, x);
+
+  if (wrap) {
+    push_sticky(p, ")");
+  }
+}
+
+static
+void binary_op_deparse(struct deparser* p,
+                       sexp* x,
+                       const char* space,
+                       bool sticky_rhs) {
+  // Constructed call without second argument
+  if (r_node_cddr(x) == r_null) {
+    call_deparse(p, x);
+    return;
+  }
+
+  sexp* outer = x;
+  sexp* op = KEEP(str_unserialise_unicode(PRINTNAME(r_node_car(x))));
+
+  x = r_node_cdr(x);
+  operand_deparse(p, r_node_car(x), outer, true);
+
+  struct r_dyn_array* p_text = p->p_text;
+  p_text->count = 0;
+  const char* c_op = Rf_translateCharUTF8(op);
+  bytes_push(p_text, space, strlen(space));
+  bytes_push(p_text, c_op, strlen(c_op));
+  bytes_push(p_text, space, strlen(space));
+  lines_push_sticky_text(p->p_info, bytes_ptr(p_text), p_text->count, p->has_colour);
+
+  if (sticky_rhs) {
+    make_next_sticky(p);
+  }
+
+  x = r_node_cdr(x);
+
+  lines_increase_indent(p->p_info);
+  operand_deparse(p, r_node_car(x), outer, false);
+  lines_decrease_indent(p->p_info);
+
+  FREE(1);
+}
+
+static
+void unary_op_deparse(struct deparser* p, sexp* x) {
+  sexp* op = KEEP(str_unserialise_unicode(PRINTNAME(r_node_car(x))));
+  push_wrapped(p, "", op, "");
+  node_deparse(p, r_node_cadr(x));
+  FREE(1);
+}
+
+static
+void args_deparse(struct deparser* p, sexp* x, const char* open, const char* close) {
+  push_sticky(p, open);
+  lines_increase_indent(p->p_info);
+
+  while (x != r_null) {
+    sexp* tag = r_node_tag(x);
+    if (tag != r_null) {
+      sym_deparse(p, tag);
+      push_sticky(p, " = ");
+      make_next_sticky(p);
+    }
+    node_deparse(p, r_node_car(x));
+
+    x = r_node_cdr(x);
+    if (x != r_null) {
+      push_sticky(p, ", ");
+    }
+  }
+
+  push_sticky(p, close);
+  lines_decrease_indent(p->p_info);
+}
+
+static
+void brackets_deparse(struct deparser* p, sexp* x, const char* open, const char* close) {
+  x = r_node_cdr(x);
+  node_deparse(p, r_node_car(x));
+  args_deparse(p, r_node_cdr(x), open, close);
+}
+
+static
+void parens_deparse(struct deparser* p, sexp* x) {
+  push(p, "(");
+  node_deparse(p, r_node_cadr(x));
+  push(p, ")");
+}
+
+static
+void braces_deparse(struct deparser* p, sexp* x) {
+  push(p, "{");
+  lines_increase_indent(p->p_info);
+
+  x = r_node_cdr(x);
+
+  // No need for a newline if the block is empty
+  if (x == r_null) {
+    push(p, " }");
+    return;
+  }
+
+  while (x != r_null) {
+    lines_push_newline(p->p_info);
+    node_deparse(p, r_node_car(x));
+    x = r_node_cdr(x);
+  }
+
+  lines_decrease_indent(p->p_info);
+  lines_push_newline(p->p_info);
+  push(p, "}");
+}
+
+enum call_delimiter {
+  CALL_DELIMITER_none,
+  CALL_DELIMITER_parens,
+  CALL_DELIMITER_backticks
+};
+
+static
+enum call_delimiter call_delimited_type(sexp* call) {
+  switch (r_which_operator(call)) {
+  case R_OP_NONE:
+  case R_OP_DOLLAR:
+  case R_OP_AT:
+  case R_OP_COLON2:
+  case R_OP_COLON3:
+  case R_OP_BRACKETS1:
+  case R_OP_BRACKETS2:
+  case R_OP_PARENTHESES:
+  case R_OP_BRACES:
+    return CALL_DELIMITER_none;
+  case R_OP_FUNCTION:
+    return CALL_DELIMITER_parens;
+  case R_OP_BREAK:
+  case R_OP_NEXT:
+  case R_OP_MAX:
+    r_abort("Internal error: Unexpected operator while deparsing");
+  default:
+    return CALL_DELIMITER_backticks;
+  }
+}
+
+static
+void call_deparse(struct deparser* p, sexp* x) {
+  sexp* car = r_node_car(x);
+
+  switch (call_delimited_type(car)) {
+  case CALL_DELIMITER_parens:
+    push(p, "(");
+    node_deparse(p, car);
+    push(p, ")");
+    break;
+  case CALL_DELIMITER_backticks:
+    node_deparse(p, r_node_car(car));
+    args_deparse(p, r_node_cdr(car), "(", ")");
+    break;
+  case CALL_DELIMITER_none:
+    node_deparse(p, car);
+    break;
+  }
+
+  args_deparse(p, r_node_cdr(x), "(", ")");
+}
+
+static
+void op_deparse(struct deparser* p, enum r_operator op, sexp* x) {
+  switch (op) {
+  case R_OP_FUNCTION: fn_call_deparse(p, x); return;
+  case R_OP_WHILE: while_deparse(p, x); return;
+  case R_OP_FOR: for_deparse(p, x); return;
+  case R_OP_REPEAT: repeat_deparse(p, x); return;
+  case R_OP_IF: if_deparse(p, x); return;
+  case R_OP_NEXT: push(p, "next"); return;
+  case R_OP_BREAK: push(p, "break"); return;
+
+  case R_OP_QUESTION:
+  case R_OP_ASSIGN1:
+  case R_OP_ASSIGN2:
+  case R_OP_ASSIGN_EQUAL:
+  case R_OP_COLON_EQUAL:
+  case R_OP_TILDE:
+  case R_OP_OR1:
+  case R_OP_OR2:
+  case R_OP_AND1:
+  case R_OP_AND2:
+  case R_OP_GREATER:
+  case R_OP_GREATER_EQUAL:
+  case R_OP_LESS:
+  case R_OP_LESS_EQUAL:
+  case R_OP_EQUAL:
+  case R_OP_NOT_EQUAL:
+  case R_OP_PLUS:
+  case R_OP_MINUS:
+  case R_OP_TIMES:
+  case R_OP_RATIO:
+  case R_OP_MODULO:
+  case R_OP_SPECIAL:
+    binary_op_deparse(p, x, " ", false);
+    return;
+
+  case R_OP_COLON1:
+  case R_OP_HAT:
+  case R_OP_DOLLAR:
+  case R_OP_AT:
+    binary_op_deparse(p, x, "", false);
+    return;
+
+  case R_OP_COLON2:
+  case R_OP_COLON3:
+    binary_op_deparse(p, x, "", true);
+    return;
+
+  case R_OP_QUESTION_UNARY:
+  case R_OP_TILDE_UNARY:
+  case R_OP_BANG1:
+  case R_OP_BANG3:
+  case R_OP_BANG2:
+  case R_OP_PLUS_UNARY:
+  case R_OP_MINUS_UNARY:
+    unary_op_deparse(p, x);
+    return;
+
+  case R_OP_BRACKETS1: brackets_deparse(p, x, "[", "]"); return;
+  case R_OP_BRACKETS2: brackets_deparse(p, x, "[[", "]]"); return;
+  case R_OP_PARENTHESES: parens_deparse(p, x); return;
+  case R_OP_BRACES: braces_deparse(p, x); return;
+
+  case R_OP_NONE:
+  case R_OP_MAX:
+    break;
+  }
+
+  r_abort("Internal error: Unexpected operator while deparsing");
+}
+
+static
+void type_sum_deparse(struct deparser* p, sexp* x, const char* suffix) {
+  sexp* type = KEEP(r_eval_with_x(type_sum_call, x, rlang_ns_env));
+  if (!r_is_string(type)) {
+    r_abort("Internal error: `type_sum()` must return a string.");
+  }
+  push_wrapped(p, "<", r_chr_get(type, 0), suffix);
+  FREE(1);
+}
+
+// All names must be non-empty for `deparse()` to create a valid
+// scalar representation, like `is_named()`
+static
+bool is_scalar_deparsable(sexp* x) {
+  if (r_typeof(x) == r_type_raw || r_length(x) != 1) {
+    return false;
+  }
+
+  sexp* nms = r_names(x);
+  return nms == r_null || !r_str_is_name(r_chr_get(nms, 0));
+}
+
+#define DEPARSE_MAX_ELTS 5
+
+// Pushes the `, ...` tail and closes the vector
+static
+void vec_deparse_close(struct deparser* p, bool truncated) {
+  if (truncated) {
+    push_sticky(p, ", ");
+    push(p, "...");
+  }
+
+  push_sticky(p, ">");
+  lines_decrease_indent(p->p_info);
+}
+
+static
+void atom_deparse(struct deparser* p, sexp* x) {
+  if (is_scalar_deparsable(x)) {
+    sexp* out = KEEP(r_eval_with_x(deparse_call, x, r_base_env));
+    push_lines(p, out);
+    FREE(1);
+    return;
+  }
+
+  r_ssize size = r_length(x);
+  bool truncated = size > DEPARSE_MAX_ELTS;
+
+  sexp* nms = r_names(x);
+  KEEP(nms);
+
+  if (truncated) {
+    sexp* subset = KEEP(r_new_vector(r_typeof(x), DEPARSE_MAX_ELTS));
+    r_vec_poke_n(subset, 0, x, 0, DEPARSE_MAX_ELTS);
+    x = subset;
+    size = DEPARSE_MAX_ELTS;
+  } else {
+    KEEP(x);
+  }
+
+  type_sum_deparse(p, x, ": ");
+  lines_increase_indent(p->p_info);
+
+  sexp* elts = KEEP(r_eval_with_x(atom_elements_call, x, rlang_ns_env));
+  sexp* const * v_elts = r_chr_deref_const(elts);
+
+  for (r_ssize i = 0; i < size; ++i) {
+    sexp* nm = r_nms_get(nms, i);
+    if (r_str_is_name(nm)) {
+      push_wrapped(p, "", nm, " = ");
+      make_next_sticky(p);
+    }
+
+    push_wrapped(p, "", v_elts[i], "");
+
+    if (i != size - 1) {
+      push_sticky(p, ", ");
+    }
+  }
+
+  vec_deparse_close(p, truncated);
+  FREE(3);
+}
+
+static
+void list_deparse(struct deparser* p, sexp* x) {
+  r_ssize size = r_length(x);
+  sexp* nms = r_names(x);
+
+  if (!size && nms != r_null) {
+    push(p, "<named list>");
+    return;
+  }
+
+  push(p, "<list: ");
+  lines_increase_indent(p->p_info);
+
+  bool truncated = size > DEPARSE_MAX_ELTS;
+  if (truncated) {
+    size = DEPARSE_MAX_ELTS;
+  }
+
+  for (r_ssize i = 0; i < size; ++i) {
+    sexp* nm = r_nms_get(nms, i);
+    if (r_str_is_name(nm)) {
+      push_wrapped(p, "", nm, " = ");
+      make_next_sticky(p);
+    }
+
+    node_deparse(p, r_list_get(x, i));
+
+    if (i != size - 1) {
+      push_sticky(p, ", ");
+    }
+  }
+
+  vec_deparse_close(p, truncated);
+}
+
+static
+void default_deparse(struct deparser* p, sexp* x) {
+  sexp* out = KEEP(r_eval_with_x(deparse_keep_integer_call, x, r_base_env));
+  push_lines(p, out);
+  FREE(1);
+}
+
+static
+void sexp_deparse(struct deparser* p, sexp* x) {
+  if (r_is_object(x)) {
+    type_sum_deparse(p, x, ">");
+    return;
+  }
+
+  switch (r_typeof(x)) {
+  case r_type_symbol: sym_deparse(p, x); return;
+  case r_type_closure: fn_deparse(p, x); return;
+  case r_type_dots: push(p, "<...>"); return;
+  case r_type_any: push(p, "<any>"); return;
+  case r_type_environment: push(p, "<environment>"); return;
+  case r_type_pointer: push(p, "<pointer>"); return;
+  case r_type_promise: push(p, "<promise>"); return;
+  case r_type_weakref: push(p, "<weakref>"); return;
+
+  case r_type_call: {
+    enum r_operator op = r_which_operator(x);
+    if (op == R_OP_NONE) {
+      call_deparse(p, x);
+    } else {
+      op_deparse(p, op, x);
+    }
+    return;
+  }
+
+  case r_type_logical:
+  case r_type_integer:
+  case r_type_double:
+  case r_type_complex:
+  case r_type_character:
+  case r_type_raw:
+    atom_deparse(p, x);
+    return;
+
+  case r_type_list:
+    list_deparse(p, x);
+    return;
+
+  default:
+    default_deparse(p, x);
+    return;
+  }
+}
+
+// Deparses a child node. Quosures are handed over to the deparser of
+// the lines object.
+static
+void node_deparse(struct deparser* p, sexp* x) {
+  if (p->quo_deparser != r_null && rlang_is_quosure(x)) {
+    r_eval_with_xyz(quo_deparser_call, p->quo_deparser, x, p->lines, r_base_env);
+  } else {
+    sexp_deparse(p, x);
+  }
+}
+
+
+enum deparse_node {
+  DEPARSE_NODE_sexp,
+  DEPARSE_NODE_call,
+  DEPARSE_NODE_fn_call,
+  DEPARSE_NODE_while,
+  DEPARSE_NODE_for,
+  DEPARSE_NODE_repeat,
+  DEPARSE_NODE_if,
+  DEPARSE_NODE_spaced_op,
+  DEPARSE_NODE_unspaced_op,
+  DEPARSE_NODE_unary_op,
+  DEPARSE_NODE_parens,
+  DEPARSE_NODE_braces
+};
+
+static
+enum deparse_node parse_deparse_node(sexp* node) {
+  if (!r_is_string(node)) {
+    r_stop_internal("parse_deparse_node", "`node` must be a string.");
+  }
+  const char* c_node = r_chr_get_c_string(node, 0);
+
+  if (!strcmp(c_node, "sexp")) return DEPARSE_NODE_sexp;
+  if (!strcmp(c_node, "call")) return DEPARSE_NODE_call;
+  if (!strcmp(c_node, "fn_call")) return DEPARSE_NODE_fn_call;
+  if (!strcmp(c_node, "while")) return DEPARSE_NODE_while;
+  if (!strcmp(c_node, "for")) return DEPARSE_NODE_for;
+  if (!strcmp(c_node, "repeat")) return DEPARSE_NODE_repeat;
+  if (!strcmp(c_node, "if")) return DEPARSE_NODE_if;
+  if (!strcmp(c_node, "spaced_op")) return DEPARSE_NODE_spaced_op;
+  if (!strcmp(c_node, "unspaced_op")) return DEPARSE_NODE_unspaced_op;
+  if (!strcmp(c_node, "unary_op")) return DEPARSE_NODE_unary_op;
+  if (!strcmp(c_node, "parens")) return DEPARSE_NODE_parens;
+  if (!strcmp(c_node, "braces")) return DEPARSE_NODE_braces;
+
+  r_stop_internal("parse_deparse_node", "Unknown node `%s`.", c_node);
+}
+
+// `lines` is a `new_lines()` object. Returns its lines once `x` has
+// been pushed.
+sexp* rlang_deparse(sexp* x, sexp* lines, sexp* node) {
+  if (r_typeof(lines) != r_type_environment) {
+    r_stop_internal("rlang_deparse", "`lines` must be an environment.");
+  }
+  sexp* buffer = r_env_find_anywhere(lines, deparse_buffer_sym);
+  sexp* has_colour = r_env_find_anywhere(lines, deparse_has_colour_sym);
+  sexp* quo_deparser = r_env_find_anywhere(lines, deparse_deparser_sym);
+
+  struct r_dyn_array* p_text = r_new_dyn_array(1, 64);
+  KEEP(p_text->shelter);
+
+  struct deparser deparser = {
+    .p_info = lines_deref(buffer),
+    .has_colour = r_as_bool(has_colour),
+    .lines = lines,
+    .quo_deparser = r_is_function(quo_deparser) ? quo_deparser : r_null,
+    .p_text = p_text
+  };
+  struct deparser* p = &deparser;
+
+  enum deparse_node c_node = parse_deparse_node(node);
+  if (c_node != DEPARSE_NODE_sexp && r_typeof(x) != r_type_call) {
+    r_stop_internal("rlang_deparse", "`x` must be a call.");
+  }
+
+  switch (c_node) {
+  case DEPARSE_NODE_sexp: sexp_deparse(p, x); break;
+  case DEPARSE_NODE_call: call_deparse(p, x); break;
+  case DEPARSE_NODE_fn_call: fn_call_deparse(p, x); break;
+  case DEPARSE_NODE_while: while_deparse(p, x); break;
+  case DEPARSE_NODE_for: for_deparse(p, x); break;
+  case DEPARSE_NODE_repeat: repeat_deparse(p, x); break;
+  case DEPARSE_NODE_if: if_deparse(p, x); break;
+  case DEPARSE_NODE_spaced_op:
+  case DEPARSE_NODE_unspaced_op:
+  case DEPARSE_NODE_unary_op:
+    if (r_typeof(r_node_car(x)) != r_type_symbol) {
+      r_stop_internal("rlang_deparse", "Operators must be symbols.");
+    }
+    if (c_node == DEPARSE_NODE_unary_op) {
+      unary_op_deparse(p, x);
+    } else {
+      binary_op_deparse(p, x, c_node == DEPARSE_NODE_spaced_op ? " " : "", false);
+    }
+    break;
+  case DEPARSE_NODE_parens: parens_deparse(p, x); break;
+  case DEPARSE_NODE_braces: braces_deparse(p, x); break;
+  }
+
+  FREE(1);
+  return lines_get(p->p_info);
+}
+
+
+void rlang_init_deparse() {
+  deparse_buffer_sym = r_sym("buffer");
+  deparse_has_colour_sym = r_sym("has_colour");
+  deparse_deparser_sym = r_sym("deparser");
+
+  deparse_call = r_parse("deparse(x)");
+  r_preserve(deparse_call);
+
+  deparse_keep_integer_call = r_parse("deparse(x, control = 'keepInteger')");
+  r_preserve(deparse_keep_integer_call);
+
+  type_sum_call = r_parse("rlang_type_sum(x)");
+  r_preserve(type_sum_call);
+
+  atom_elements_call = r_parse("atom_elements(x)");
+  r_preserve(atom_elements_call);
+
+  quo_deparser_call = r_parse("x(y, lines = z)");
+  r_preserve(quo_deparser_call);
+}
@@ -361,8 +361,11 @@ static sexp* dots_unquote(sexp* dots, struct dots_capture_info* capture_info) {
     sexp* env = dot_get_env(elt);
 
     // Unquoting rearranges expressions
-    // FIXME: Only duplicate the call tree, not the leaves
-    expr = KEEP(r_copy(expr));
+    bool needs_interp = call_needs_interp(expr);
+    if (needs_interp) {
+      expr = call_tree_copy(expr);
+    }
+    KEEP(expr);
 
     if (unquote_names && r_is_call(expr, ":=")) {
       if (r_node_tag(node) != r_null) {
@@ -413,7 +416,9 @@ static sexp* dots_unquote(sexp* dots, struct dots_capture_info* capture_info) {
     case OP_EXPR_FIXUP:
     case OP_EXPR_DOT_DATA:
     case OP_EXPR_CURLY:
-      expr = call_interp_impl(expr, env, info);
+      if (needs_interp) {
+        expr = call_interp_impl(expr, env, info);
+      }
       capture_info->count += 1;
       break;
     case OP_EXPR_UQS:
@@ -424,7 +429,10 @@ static sexp* dots_unquote(sexp* dots, struct dots_capture_info* capture_info) {
     case OP_QUO_FIXUP:
     case OP_QUO_DOT_DATA:
     case OP_QUO_CURLY: {
-      expr = KEEP(call_interp_impl(expr, env, info));
+      if (needs_interp) {
+        expr = call_interp_impl(expr, env, info);
+      }
+      KEEP(expr);
       expr = forward_quosure(expr, env);
       FREE(1);
       capture_info->count += 1;
@@ -43,13 +43,59 @@ sexp* rlang_env_get_sym(sexp* env, sexp* sym, bool inherit, sexp* closure_env) {
   return out;
 }
 
+/**
+ * Binding names are supplied either as a character vector or as a
+ * list of symbols, e.g. created with `syms()`. Strings are interned
+ * with a lookup in the global symbol table on each call. Symbol lists
+ * can be created once and reused across many environments.
+ */
+static inline
+bool nms_are_symbols(sexp* nms, const char* arg) {
+  switch (r_typeof(nms)) {
+  case r_type_character:
+    return false;
+  case r_type_list:
+    return true;
+  default:
+    r_abort("`%s` must be a character vector or a list of symbols.", arg);
+  }
+}
+
+static inline
+sexp* nms_get_sym(sexp* nms, bool symbols, r_ssize i) {
+  if (!symbols) {
+    return r_str_as_symbol(r_chr_get(nms, i));
+  }
+
+  sexp* sym = r_list_get(nms, i);
+  if (r_typeof(sym) != r_type_symbol) {
+    r_abort("Binding names must be symbols.");
+  }
+  return sym;
+}
+
+static
+sexp* nms_as_names(sexp* nms, bool symbols) {
+  if (!symbols) {
+    return nms;
+  }
+
+  r_ssize n = r_length(nms);
+  sexp* names = KEEP(r_new_vector(r_type_character, n));
+
+  for (r_ssize i = 0; i < n; ++i) {
+    r_chr_poke(names, i, r_sym_string(nms_get_sym(nms, true, i)));
+  }
+
+  FREE(1);
+  return names;
+}
+
 sexp* rlang_env_get_list(sexp* env, sexp* nms, sexp* inherit, sexp* closure_env) {
   if (r_typeof(env) != r_type_environment) {
     r_abort("`env` must be an environment.");
   }
-  if (r_typeof(nms) != r_type_character) {
-    r_abort("`nm` must be a string.");
-  }
+  bool symbols = nms_are_symbols(nms, "nms");
   if (!r_is_bool(inherit)) {
     r_abort("`inherit` must be a logical value.");
   }
@@ -58,16 +104,14 @@ sexp* rlang_env_get_list(sexp* env, sexp* nms, sexp* inherit, sexp* closure_env)
   r_ssize n = r_length(nms);
 
   sexp* out = KEEP(r_new_vector(r_type_list, n));
-  r_attrib_poke_names(out, nms);
-
-  sexp* const * p_nms = r_chr_deref_const(nms);
 
   for (r_ssize i = 0; i <n; ++i) {
-    sexp* sym = r_str_as_symbol(p_nms[i]);
+    sexp* sym = nms_get_sym(nms, symbols, i);
     sexp* elt = rlang_env_get_sym(env, sym, c_inherit, closure_env);
     r_list_poke(out, i, elt);
   }
 
+  r_attrib_poke_names(out, nms_as_names(nms, symbols));
   FREE(1);
   return out;
 }
@@ -76,9 +120,7 @@ sexp* rlang_env_has(sexp* env, sexp* nms, sexp* inherit) {
   if (r_typeof(env) != r_type_environment) {
     r_abort("`env` must be an environment.");
   }
-  if (r_typeof(nms) != r_type_character) {
-    r_abort("`nms` must be a character vector.");
-  }
+  bool symbols = nms_are_symbols(nms, "nms");
   if (r_typeof(inherit) != r_type_logical) {
     r_abort("`inherit` must be a logical value.");
   }
@@ -87,21 +129,20 @@ sexp* rlang_env_has(sexp* env, sexp* nms, sexp* inherit) {
   sexp* out = KEEP(r_new_vector(r_type_logical, n));
 
   int* p_out = r_lgl_deref(out);
-  sexp* const * p_nms = r_chr_deref_const(nms);
 
   if (r_lgl_get(inherit, 0)) {
     for (r_ssize i = 0; i < n; ++i) {
-      sexp* sym = r_str_as_symbol(p_nms[i]);
+      sexp* sym = nms_get_sym(nms, symbols, i);
       p_out[i] = r_env_has_anywhere(env, sym);
     }
   } else {
     for (r_ssize i = 0; i < n; ++i) {
-      sexp* sym = r_str_as_symbol(p_nms[i]);
+      sexp* sym = nms_get_sym(nms, symbols, i);
       p_out[i] = r_env_has(env, sym);
     }
   }
 
-  r_attrib_poke_names(out, nms);
+  r_attrib_poke_names(out, nms_as_names(nms, symbols));
   FREE(1);
   return out;
 }
@@ -155,6 +196,7 @@ sexp* rlang_env_poke(sexp* env, sexp* nm, sexp* value, sexp* inherit, sexp* crea
     }
   }
   env_poke_or_zap(env, sym, value);
+  rlang_data_pronoun_cache_invalidate(env);
 
   FREE(1);
   return old;
@@ -176,6 +218,12 @@ enum bind_type parse_bind_type(sexp* bind_type) {
   }
 }
 
+static sexp* env_bind(sexp* env,
+                      sexp* values,
+                      bool needs_old,
+                      enum bind_type bind_type,
+                      sexp* eval_env);
+
 sexp* rlang_env_bind(sexp* env,
                      sexp* values,
                      sexp* needs_old,
@@ -192,6 +240,41 @@ sexp* rlang_env_bind(sexp* env,
     r_stop_internal("rlang_env_bind", "`values` must be a list.");
   }
 
+  sexp* old = KEEP(env_bind(env, values, c_needs_old, c_bind_type, eval_env));
+  rlang_data_pronoun_cache_invalidate(env);
+
+  FREE(1);
+  return old;
+}
+
+// Allocates the environment without evaluating `new.env()` and with
+// a hash table large enough to hold the initial bindings. A fresh
+// environment can't be part of a data mask so the `.data` cache is
+// left alone.
+sexp* rlang_new_environment(sexp* parent, sexp* values) {
+  if (r_typeof(parent) != r_type_environment) {
+    r_abort("`parent` must be an environment.");
+  }
+  if (r_typeof(values) != r_type_list) {
+    r_stop_internal("rlang_new_environment", "`values` must be a list.");
+  }
+
+  r_ssize n = r_length(values);
+  r_ssize size = n ? r_ssize_max(29, n + n / 4) : 0;
+
+  sexp* env = KEEP(r_new_environment(parent, size));
+  env_bind(env, values, false, BIND_TYPE_value, r_null);
+
+  FREE(1);
+  return env;
+}
+
+static
+sexp* env_bind(sexp* env,
+               sexp* values,
+               bool needs_old,
+               enum bind_type bind_type,
+               sexp* eval_env) {
   r_ssize n = r_length(values);
   if (!n) {
     return r_lists_empty;
@@ -204,7 +287,7 @@ sexp* rlang_env_bind(sexp* env,
   sexp* const * p_names = r_chr_deref_const(names);
 
   sexp* old = r_null;
-  if (c_needs_old) {
+  if (needs_old) {
     old = KEEP(r_new_vector(r_type_list, n));
     r_attrib_poke_names(old, names);
   } else {
@@ -215,14 +298,14 @@ sexp* rlang_env_bind(sexp* env,
     sexp* sym = r_str_as_symbol(p_names[i]);
     sexp* value = r_list_get(values, i);
 
-    if (c_needs_old) {
+    if (needs_old) {
       r_list_poke(old, i, env_get(env, sym));
     }
 
     if (value == rlang_zap) {
       r_env_unbind(env, sym);
     } else {
-      switch (c_bind_type) {
+      switch (bind_type) {
       case BIND_TYPE_value: r_env_poke(env, sym, value); break;
       case BIND_TYPE_lazy: env_poke_lazy(env, sym, value, eval_env); break;
       case BIND_TYPE_active: env_poke_active(env, sym, value, eval_env); break;
@@ -245,6 +328,9 @@ sexp* rlang_env_unbind(sexp* env, sexp* names, sexp* inherits) {
     r_abort("`inherits` must be a logical value.");
   }
 
+  // Removing bindings doesn't invalidate the `.data` cache since
+  // lookups fall back to a full walk when a cached binding is gone
+
   if (*r_lgl_deref(inherits)) {
     r_env_unbind_anywhere_names(env, names);
   } else {
@@ -1,5 +1,6 @@
 #include <rlang.h>
 #include "internal.h"
+#include "vec-view.h"
 
 
 static sexp* quo_mask_flag_sym = NULL;
@@ -195,15 +196,176 @@ sexp* rlang_is_data_mask(sexp* env) {
   return r_lgl(mask_info(env).type == RLANG_MASK_DATA);
 }
 
+
+/**
+ * The `.data` pronoun of a multi-level data mask caches the
+ * environment in which each symbol was found. The cache lives in the
+ * mask under `data_mask_cache_sym` as a list of the generation at
+ * which it was created and a hashed environment mapping symbols to
+ * the environment that binds them.
+ *
+ * Since caching the location of a binding doesn't capture shadowing
+ * by bindings added further down the mask, the levels of cached masks
+ * are registered in `mask_levels` and the generation is bumped when
+ * rlang adds bindings to one of them. Removing bindings doesn't need
+ * invalidation because lookups fall back to a full walk when the
+ * cached binding is gone. Modifying the mask with base functions like
+ * `assign()` is not detected.
+ *
+ * `mask_levels` is a set of environment pointers that doesn't protect
+ * its elements. A pointer recycled by the GC may cause a spurious
+ * invalidation but never a missed one. When the levels of a mask don't
+ * fit in the set, it is cleared and the generation is bumped so that
+ * all caches register their levels again. This happens before any
+ * level of the mask is registered so that a cache is never stamped
+ * with a generation that missed some of its levels. Masks with more
+ * levels than the set can hold are not cached.
+ */
+
+static sexp* data_mask_cache_sym = NULL;
+static double data_pronoun_cache_generation = 0;
+
+#define MASK_LEVELS_BITS 8
+#define MASK_LEVELS_SIZE (1 << MASK_LEVELS_BITS)
+
+// Keep the table sparse so that probe sequences stay short
+#define MASK_LEVELS_MAX_COUNT (MASK_LEVELS_SIZE / 2)
+static sexp* mask_levels[MASK_LEVELS_SIZE] = { NULL };
+static int mask_levels_count = 0;
+
+static inline
+uint32_t mask_levels_hash(sexp* env) {
+  // Fibonacci hashing of the environment address
+  uint64_t hash = ((uint64_t) (uintptr_t) env) * UINT64_C(0x9E3779B97F4A7C15);
+  return hash >> (64 - MASK_LEVELS_BITS);
+}
+
+static
+bool mask_levels_has(sexp* env) {
+  if (!mask_levels_count) {
+    return false;
+  }
+
+  uint32_t i = mask_levels_hash(env);
+  while (mask_levels[i]) {
+    if (mask_levels[i] == env) {
+      return true;
+    }
+    i = (i + 1) % MASK_LEVELS_SIZE;
+  }
+
+  return false;
+}
+
+static
+void mask_levels_add(sexp* env) {
+  uint32_t i = mask_levels_hash(env);
+  while (mask_levels[i]) {
+    if (mask_levels[i] == env) {
+      return;
+    }
+    i = (i + 1) % MASK_LEVELS_SIZE;
+  }
+
+  mask_levels[i] = env;
+  ++mask_levels_count;
+}
+
+// Makes room for `n` levels, invalidating all caches if needed
+static
+void mask_levels_reserve(int n) {
+  if (mask_levels_count + n <= MASK_LEVELS_MAX_COUNT) {
+    return;
+  }
+
+  memset(mask_levels, 0, sizeof(mask_levels));
+  mask_levels_count = 0;
+  ++data_pronoun_cache_generation;
+}
+
+// Called after bindings are added to `env`
+void rlang_data_pronoun_cache_invalidate(sexp* env) {
+  if (mask_levels_has(env)) {
+    ++data_pronoun_cache_generation;
+  }
+}
+
+static
+sexp* mask_cache(sexp* mask, sexp* top) {
+  sexp* cache = r_env_find(mask, data_mask_cache_sym);
+
+  if (r_typeof(cache) == r_type_list &&
+      r_length(cache) == 2 &&
+      r_typeof(r_list_get(cache, 0)) == r_type_double &&
+      r_dbl_get(r_list_get(cache, 0), 0) == data_pronoun_cache_generation) {
+    return r_list_get(cache, 1);
+  }
+
+  int n_levels = 0;
+  sexp* level = r_env_parent(mask);
+  while (true) {
+    ++n_levels;
+    if (level == top || level == r_empty_env) {
+      break;
+    }
+    level = r_env_parent(level);
+  }
+
+  if (n_levels > MASK_LEVELS_MAX_COUNT) {
+    return r_null;
+  }
+
+  // Reserve before registering as this may bump the generation
+  mask_levels_reserve(n_levels);
+
+  level = r_env_parent(mask);
+  while (true) {
+    mask_levels_add(level);
+    if (level == top || level == r_empty_env) {
+      break;
+    }
+    level = r_env_parent(level);
+  }
+
+  cache = KEEP(r_new_list(2));
+  r_list_poke(cache, 0, r_dbl(data_pronoun_cache_generation));
+  r_list_poke(cache, 1, r_new_environment(r_empty_env, 0));
+  r_env_poke(mask, data_mask_cache_sym, cache);
+
+  FREE(1);
+  return r_list_get(cache, 1);
+}
+
+static inline
+sexp* mask_find_in(sexp* env, sexp* sym) {
+  sexp* obj = r_env_find(env, sym);
+
+  if (r_typeof(obj) == r_type_promise) {
+    KEEP(obj);
+    obj = r_eval(obj, r_empty_env);
+    FREE(1);
+  }
+
+  return obj;
+}
+
 static sexp* mask_find(sexp* env, sexp* sym) {
   if (r_typeof(sym) != r_type_symbol) {
     r_abort("Internal error: Data pronoun must be subset with a symbol");
   }
 
+  sexp* cache = r_null;
+
   sexp* top_env = r_env_find(env, data_mask_top_env_sym);
   if (r_typeof(top_env) == r_type_environment) {
     // Start lookup in the parent if the pronoun wraps a data mask
+    sexp* mask = env;
     env = r_env_parent(env);
+
+    // Walking a single level is as fast as the cache
+    if (env != top_env) {
+      cache = mask_cache(mask, top_env);
+    }
   } else {
     // Data pronouns created from lists or data frames are converted
     // to a simple environment whose ancestry shouldn't be looked up.
@@ -211,17 +373,33 @@ static sexp* mask_find(sexp* env, sexp* sym) {
   }
   int n_kept = 0;
   KEEP_N(top_env, &n_kept);
+  KEEP_N(cache, &n_kept);
+
+  if (cache != r_null) {
+    sexp* found_env = r_env_find(cache, sym);
+
+    if (r_typeof(found_env) == r_type_environment) {
+      sexp* obj = mask_find_in(found_env, sym);
+
+      // Fall back to a full lookup if the binding was removed
+      if (obj != r_syms_unbound) {
+        FREE(n_kept);
+        return obj;
+      }
+    }
+  }
 
   sexp* cur = env;
   do {
-    sexp* obj = r_env_find(cur, sym);
-    if (TYPEOF(obj) == PROMSXP) {
-      KEEP(obj);
-      obj = r_eval(obj, r_empty_env);
-      FREE(1);
-    }
+    sexp* obj = mask_find_in(cur, sym);
 
     if (obj != r_syms_unbound) {
+      if (cache != r_null) {
+        KEEP(obj);
+        r_env_poke(cache, sym, cur);
+        FREE(1);
+      }
+
       FREE(n_kept);
       return obj;
     }
@@ -451,8 +629,8 @@ sexp* rlang_ext2_tilde_eval(sexp* call, sexp* op, sexp* args, sexp* rho) {
   return rlang_tilde_eval(tilde, current_frame, caller_frame);
 }
 
-static const char* data_mask_objects_names[4] = {
-  ".__tidyeval_data_mask__.", "~", ".top_env", ".env"
+static const char* data_mask_objects_names[5] = {
+  ".__tidyeval_data_mask__.", "~", ".top_env", ".env", ".__tidyeval_data_mask_cache__."
 };
 
 // Soft-deprecated in rlang 0.2.0
@@ -494,10 +672,113 @@ static sexp* new_quosure_mask(sexp* env) {
   return mask;
 }
 
+/**
+ * Opt-in cache of quosure expressions compiled to bytecode. Entries
+ * are keyed by quosure identity and record the quosure environment,
+ * so that an entry is not reused if the environment of the quosure
+ * was changed in place. Expressions are compiled in the evaluation
+ * environment once the mask has been rechained to the quosure
+ * environment, so the compiler sees the same scope as the evaluation.
+ * Data masks are created afresh for each evaluation and are not part
+ * of the key, which means the entries don't keep them alive.
+ *
+ * Since entries are reused across masks with different columns, the
+ * expressions are compiled without optimisations. At higher levels
+ * the compiler folds constants such as `pi` or `T` and inlines base
+ * functions that are not shadowed at compile time, which would
+ * ignore columns of later masks with these names.
+ */
+
+#define COMPILE_CACHE_MAX_SIZE 1024
+
+static bool compile_cache_enabled = false;
+static struct r_dict* p_compile_cache = NULL;
+static sexp* compile_cache_shelter = NULL;
+static r_ssize compile_cache_hits = 0;
+static r_ssize compile_cache_misses = 0;
+static sexp* compile_call = NULL;
+
+static
+void compile_cache_reset() {
+  p_compile_cache = r_new_dict(COMPILE_CACHE_MAX_SIZE);
+  r_list_poke(compile_cache_shelter, 0, p_compile_cache->shelter);
+}
+
+static
+sexp* quo_compiled_expr(sexp* quo, sexp* expr, sexp* eval_env) {
+  if (!compile_cache_enabled || quo == r_null || r_typeof(expr) != r_type_call) {
+    return expr;
+  }
+
+  sexp* env = r_quo_get_env(quo);
+
+  sexp* entry = r_dict_get0(p_compile_cache, quo);
+  if (entry && r_list_get(entry, 0) == env) {
+    ++compile_cache_hits;
+    return r_list_get(entry, 1);
+  }
+  ++compile_cache_misses;
+
+  sexp* code = KEEP(r_eval_with_xy(compile_call, expr, eval_env, r_base_env));
+
+  entry = KEEP(r_new_list(2));
+  r_list_poke(entry, 0, env);
+  r_list_poke(entry, 1, code);
+
+  // Keep memory bounded by starting afresh once the cache is full
+  if (p_compile_cache->n_entries >= COMPILE_CACHE_MAX_SIZE) {
+    compile_cache_reset();
+  }
+  r_dict_poke(p_compile_cache, quo, entry);
+
+  FREE(2);
+  return code;
+}
+
+sexp* rlang_eval_tidy_cache_enable(sexp* enable) {
+  if (!r_is_bool(enable)) {
+    r_abort("`enable` must be a logical value.");
+  }
+
+  bool old = compile_cache_enabled;
+  compile_cache_enabled = r_lgl_get(enable, 0);
+
+  if (!compile_cache_enabled) {
+    compile_cache_reset();
+  }
+
+  return r_lgl(old);
+}
+sexp* rlang_eval_tidy_cache_stats() {
+  sexp* out = KEEP(r_new_double(3));
+  double* p_out = r_dbl_deref(out);
+
+  p_out[0] = compile_cache_hits;
+  p_out[1] = compile_cache_misses;
+  p_out[2] = p_compile_cache->n_entries;
+
+  static const char* names[3] = { "hits", "misses", "size" };
+  r_attrib_poke_names(out, r_chr_n(names, 3));
+
+  FREE(1);
+  return out;
+}
+sexp* rlang_eval_tidy_cache_reset() {
+  compile_cache_hits = 0;
+  compile_cache_misses = 0;
+  compile_cache_reset();
+  return r_null;
+}
+
+
+static sexp* eval_in_data_mask(sexp* quo, sexp* expr, sexp* env, sexp* mask, sexp* top);
+
 sexp* rlang_eval_tidy(sexp* expr, sexp* data, sexp* env) {
   int n_kept = 0;
 
+  sexp* quo = r_null;
   if (rlang_is_quosure(expr)) {
+    quo = expr;
     env = r_quo_get_env(expr);
     expr = r_quo_get_expr(expr);
   }
@@ -506,6 +787,8 @@ sexp* rlang_eval_tidy(sexp* expr, sexp* data, sexp* env) {
   // for quosure thunks. Otherwise we create a heavier data mask with
   // all the masking objects, data pronouns, etc.
   if (data == r_null) {
+    expr = KEEP_N(quo_compiled_expr(quo, expr, env), &n_kept);
+
     sexp* mask = KEEP_N(new_quosure_mask(env), &n_kept);
     sexp* out = r_eval(expr, mask);
     FREE(n_kept);
@@ -515,6 +798,14 @@ sexp* rlang_eval_tidy(sexp* expr, sexp* data, sexp* env) {
   sexp* mask = KEEP_N(rlang_as_data_mask(data), &n_kept);
   sexp* top = KEEP_N(env_get_top_binding(mask), &n_kept);
 
+  sexp* out = eval_in_data_mask(quo, expr, env, mask, top);
+  FREE(n_kept);
+  return out;
+}
+
+// `quo` is `NULL` when evaluating a bare expression
+static
+sexp* eval_in_data_mask(sexp* quo, sexp* expr, sexp* env, sexp* mask, sexp* top) {
   // Rechain the mask on the new lexical env but don't restore it on
   // exit. This way leaked masks inherit from a somewhat sensible
   // environment. We could do better with ALTENV and two-parent data
@@ -535,8 +826,163 @@ sexp* rlang_eval_tidy(sexp* expr, sexp* data, sexp* env) {
     r_env_poke_parent(top, env);
   }
 
+  expr = KEEP(quo_compiled_expr(quo, expr, mask));
   sexp* out = r_eval(expr, mask);
-  FREE(n_kept);
+
+  FREE(1);
+  return out;
+}
+
+// Evaluates quosures in turn within a single data mask. Each named
+// result is bound in the bottom of the mask so that subsequent
+// quosures can refer to it, as in `dplyr::mutate()`.
+sexp* rlang_eval_tidy_list(sexp* quos, sexp* data, sexp* names) {
+  if (r_typeof(quos) != r_type_list) {
+    r_abort("`quos` must be a list of quosures");
+  }
+  r_ssize n = r_length(quos);
+
+  if (names == r_null) {
+    names = r_names(quos);
+  }
+  if (names != r_null) {
+    if (r_typeof(names) != r_type_character) {
+      r_abort("`names` must be a character vector");
+    }
+    if (r_length(names) != n) {
+      r_abort("`names` must have the same length as `quos`");
+    }
+  }
+
+  sexp* const * p_quos = r_list_deref_const(quos);
+  for (r_ssize i = 0; i < n; ++i) {
+    if (!rlang_is_quosure(p_quos[i])) {
+      r_abort("`quos` must be a list of quosures");
+    }
+  }
+
+  sexp* mask = KEEP(rlang_as_data_mask(data));
+  sexp* top = KEEP(env_get_top_binding(mask));
+
+  // Masks created from `NULL` are their own bottom. Otherwise the mask
+  // is a child of the bottom environment. Binding results there rather
+  // than in the mask itself makes them visible through the `.data`
+  // pronoun as well.
+  sexp* bottom = (mask == top) ? mask : r_env_parent(mask);
+
+  sexp* out = KEEP(r_new_list(n));
+
+  for (r_ssize i = 0; i < n; ++i) {
+    sexp* quo = p_quos[i];
+    sexp* env = r_quo_get_env(quo);
+    sexp* expr = r_quo_get_expr(quo);
+
+    sexp* value = eval_in_data_mask(quo, expr, env, mask, top);
+    r_list_poke(out, i, value);
+
+    if (names != r_null) {
+      sexp* nm = r_chr_get(names, i);
+      if (r_str_is_name(nm)) {
+        r_env_poke(bottom, r_str_as_symbol(nm), value);
+        rlang_data_pronoun_cache_invalidate(bottom);
+      }
+    }
+  }
+
+  if (names != r_null) {
+    r_attrib_poke(out, r_syms_names, names);
+  }
+
+  FREE(3);
+  return out;
+}
+
+// Evaluates `quo` once per group of contiguous rows of `data`. The
+// columns are bound in the mask as views of the group rows, which
+// avoids copying the data of each group.
+sexp* rlang_eval_tidy_grouped(sexp* quo, sexp* data, sexp* starts, sexp* sizes) {
+  if (!rlang_is_quosure(quo)) {
+    r_abort("`quo` must be a quosure");
+  }
+  if (r_typeof(data) != r_type_list) {
+    r_abort("`data` must be a list or data frame");
+  }
+  check_unique_names(data);
+
+  if (r_typeof(starts) != r_type_integer || r_typeof(sizes) != r_type_integer) {
+    r_abort("`starts` and `sizes` must be integer vectors");
+  }
+  r_ssize n_groups = r_length(starts);
+  if (r_length(sizes) != n_groups) {
+    r_abort("`starts` and `sizes` must have the same length");
+  }
+
+  r_ssize n_cols = r_length(data);
+  sexp* const * p_cols = r_list_deref_const(data);
+
+  r_ssize n_rows = n_cols ? r_length(p_cols[0]) : 0;
+  for (r_ssize j = 1; j < n_cols; ++j) {
+    if (r_length(p_cols[j]) != n_rows) {
+      r_abort("The columns of `data` must have the same size");
+    }
+  }
+
+  const int* p_starts = r_int_deref_const(starts);
+  const int* p_sizes = r_int_deref_const(sizes);
+
+  for (r_ssize i = 0; i < n_groups; ++i) {
+    int start = p_starts[i];
+    int size = p_sizes[i];
+
+    if (start == r_ints_na || size == r_ints_na ||
+        start < 1 || size < 0 ||
+        (r_ssize) start - 1 + size > n_rows) {
+      r_abort("Group %" R_PRIdXLEN_T " is out of bounds", (R_xlen_t) i + 1);
+    }
+  }
+
+  // Intern the column symbols once for all groups
+  sexp* syms = KEEP(r_new_list(n_cols));
+  if (n_cols) {
+    sexp* const * p_names = r_chr_deref_const(r_names(data));
+    for (r_ssize j = 0; j < n_cols; ++j) {
+      if (r_str_is_name(p_names[j])) {
+        r_list_poke(syms, j, r_str_as_symbol(p_names[j]));
+      }
+    }
+  }
+  sexp* const * p_syms = r_list_deref_const(syms);
+
+  sexp* bottom = KEEP(r_new_environment(r_empty_env, mask_length(n_cols)));
+  sexp* mask = KEEP(rlang_new_data_mask(bottom, bottom));
+
+  sexp* pronoun = KEEP(rlang_as_data_pronoun(mask));
+  r_env_poke(bottom, data_pronoun_sym, pronoun);
+
+  sexp* env = r_quo_get_env(quo);
+  sexp* expr = r_quo_get_expr(quo);
+
+  sexp* out = KEEP(r_new_list(n_groups));
+
+  for (r_ssize i = 0; i < n_groups; ++i) {
+    r_ssize start = p_starts[i] - 1;
+    r_ssize size = p_sizes[i];
+
+    for (r_ssize j = 0; j < n_cols; ++j) {
+      sexp* sym = p_syms[j];
+      if (sym == r_null) {
+        continue;
+      }
+
+      sexp* view = KEEP(r_vec_view(p_cols[j], start, size));
+      r_env_poke(bottom, sym, view);
+      FREE(1);
+    }
+
+    r_list_poke(out, i, eval_in_data_mask(quo, expr, env, mask, bottom));
+  }
+
+  FREE(5);
   return out;
 }
 
@@ -579,6 +1025,7 @@ void rlang_init_eval_tidy() {
   data_mask_flag_sym = r_sym(".__tidyeval_data_mask__.");
   data_mask_env_sym = r_sym(".env");
   data_mask_top_env_sym = r_sym(".top_env");
+  data_mask_cache_sym = r_sym(".__tidyeval_data_mask_cache__.");
   data_pronoun_sym = r_sym(".data");
 
   tilde_prim = r_base_ns_get("~");
@@ -607,5 +1054,12 @@ void rlang_init_eval_tidy() {
   );
   r_preserve(restore_mask_fn);
 
+  compile_call = r_parse("compiler::compile(x, y, options = list(optimize = 0L))");
+  r_preserve(compile_call);
+
+  compile_cache_shelter = r_new_list(1);
+  r_preserve(compile_cache_shelter);
+  compile_cache_reset();
+
   FREE(1);
 }
@@ -206,18 +206,24 @@
  * in conjunction.
  *
  * In addition we also need to deal with multiple `!!` calls in a
- * series of binary operations. This is handled by recursing from the
- * upper pivot (the new root) after rotation. Finally the possibility
- * of intervening unary `+` or `-` operations also needs special
- * handling.
+ * series of binary operations. This is handled by expanding again
+ * from the upper pivot (the new root) after rotation. Finally the
+ * possibility of intervening unary `+` or `-` operations also needs
+ * special handling.
  *
  * All operators whose precedence lies between prec(`!`) and
  * prec(`!!`) might be involved in such a fixup of the AST. We call
  * these the "problematic" operators. Since the root can be multiple
  * expressions deep, we can't tell in advance whether the current
- * operation in the AST is involved in a rotation. Hence we apply
- * node_list_interp_fixup() instead of node_list_interp() whenever we
- * reach a problematic operator.
+ * operation in the AST is involved in a rotation. Hence we climb
+ * problematic operators with fixup_climb() and record them in a path
+ * from which the upper root is chosen once a pivot is found.
+ *
+ * Machine-generated code may contain series of thousands of binary
+ * operations. To avoid overflowing the C stack, the AST is climbed
+ * with loops rather than recursive calls. After a rotation, the climb
+ * resumes from the upper pivot instead of starting over from the
+ * root, so that series of `!!` calls are expanded in linear time.
  */
 
 
@@ -274,76 +280,51 @@ static void initialise_rotation_info(struct ast_rotation_info* info) {
 }
 
 // Defined below
-static sexp* node_list_interp_fixup(sexp* x, sexp* parent, sexp* env,
-                                    struct ast_rotation_info* rotation_info,
-                                    bool expand_lhs);
+static sexp* fixup_expand(sexp* x, sexp* env, bool expand_lhs);
 
-/**
- * maybe_rotate() - Rotate if we found a pivot
- *
- * @op: Problematic operator.
- * @env: The unquoting environment.
- * @info: See &struct ast_rotation_info.
- *
- * If @op has precedence over the upper pivot, this is the upper
- * root. Otherwise use &ast_rotation_info->upper_root. If the latter
- * is not defined, this means no rotation is needed because the effect
- * of `!` on the AST corresponds to the implicit grouping (e.g. with
- * `1 + !!2 * 3`).
- */
-static sexp* maybe_rotate(sexp* op, sexp* env, struct ast_rotation_info* info) {
-  if (info->upper_pivot_op == R_OP_NONE) {
-    return op;
-  }
-
-  // Rotate if `op` is the upper root
-  if (r_lhs_op_has_precedence(r_which_operator(op), info->upper_pivot_op)) {
-    // Swap the lower root's RHS with the lower pivot's LHS
-    r_node_poke_car(info->lower_root, r_node_cadr(info->lower_pivot));
-    r_node_poke_cadr(info->lower_pivot, op);
-
-    // After rotation the upper pivot is the new root
-    op = info->upper_pivot;
-  } else if (info->upper_root) {
-    r_node_poke_car(info->lower_root, r_node_cadr(info->lower_pivot));
-    r_node_poke_cadr(info->lower_pivot, info->upper_root);
-    r_node_poke_car(r_node_cddr(info->root_parent), info->upper_pivot);
+static sexp* fixup_interp_impl(sexp* x, sexp* env, bool expand_lhs) {
+  // Happens with constructed calls without arguments such as `/`()
+  if (r_node_cdr(x) == r_null) {
+    return x;
   }
-  // else there is no rotation needed
-
-  // Reinitialise the `ast_rotation_info` on the stack in order to
-  // reuse it in the recursion
-  initialise_rotation_info(info);
 
-  // Recurse on the RHS of the upper pivot (which is now the new root)
-  node_list_interp_fixup(op, NULL, env, info, false);
-  return maybe_rotate(op, env, info);
+  // Look for problematic !! calls and expand arguments on the way.
+  // If a pivot is found rotate it around `x`.
+  return fixup_expand(x, env, expand_lhs);
 }
 
-/**
- * fixup_interp() - Expand a problematic operation
- *
- * @x: A problematic operation, i.e. a call to an operator whose
- *   precedence is between that of `!` and that of `!!`.
- * @env: The unquoting environment.
- *
- * The expression to expand is an operator that might need changes in
- * the AST if we find a `!!` call down the line. From this point on
- * there is a &struct ast_rotation_info on the stack.
- */
 sexp* fixup_interp(sexp* x, sexp* env) {
-  // Happens with constructed calls without arguments such as `/`()
-  if (r_node_cdr(x) == r_null) {
-    return x;
+  // The LHS of a problematic operation is expanded with its own
+  // rotation info before the operation itself. Left-associative
+  // series like `a + b + c` are pulled downward in the AST, so we
+  // climb their LHS's first and then expand the operations from the
+  // bottom up.
+  struct r_dyn_array* p_stack = r_new_dyn_array(sizeof(sexp*), 16);
+  KEEP(p_stack->shelter);
+
+  while (r_node_cdr(x) != r_null && !is_unary_plusminus(x)) {
+    sexp* lhs = r_node_cadr(x);
+    if (!is_problematic_op(lhs)) {
+      break;
+    }
+
+    r_arr_push_back(p_stack, &x);
+    x = lhs;
   }
 
-  struct ast_rotation_info rotation_info;
-  initialise_rotation_info(&rotation_info);
+  sexp* out = fixup_interp_impl(x, env, true);
 
-  // Look for problematic !! calls and expand arguments on the way.
-  // If a pivot is found rotate it around `x`.
-  node_list_interp_fixup(x, NULL, env, &rotation_info, true);
-  return maybe_rotate(x, env, &rotation_info);
+  while (p_stack->count) {
+    x = *((sexp**) r_arr_ptr_back(p_stack));
+    r_arr_pop_back(p_stack);
+
+    // The LHS has already been expanded
+    r_node_poke_cadr(x, out);
+    out = fixup_interp_impl(x, env, false);
+  }
+
+  FREE(1);
+  return out;
 }
 
 /**
@@ -370,11 +351,7 @@ sexp* fixup_interp_first(sexp* x, sexp* env) {
   r_node_poke_cadr(parent, r_eval(target, env));
 
   // Expand the new root but no need to expand LHS as we just unquoted it
-  struct ast_rotation_info rotation_info;
-  initialise_rotation_info(&rotation_info);
-
-  node_list_interp_fixup(x, NULL, env, &rotation_info, false);
-  return maybe_rotate(x, env, &rotation_info);
+  return fixup_expand(x, env, false);
 }
 
 /**
@@ -430,153 +407,285 @@ static void find_upper_pivot(sexp* x, struct ast_rotation_info* info) {
  */
 static void find_lower_pivot(sexp* x, sexp* parent_node, sexp* env,
                              struct ast_rotation_info* info) {
-  sexp* lhs_node = r_node_cdr(x);
-  sexp* rhs_node = r_node_cdr(lhs_node);
-
-  // We found an unary `+` or `-` on the way
-  if (rhs_node == r_null) {
-    sexp* target = r_eval(x, env);
+  while (true) {
+    sexp* lhs_node = r_node_cdr(x);
+    sexp* rhs_node = r_node_cdr(lhs_node);
+
+    // We found an unary `+` or `-` on the way
+    if (rhs_node == r_null) {
+      sexp* target = r_eval(x, env);
+
+      if (parent_node) {
+        r_node_poke_car(parent_node, target);
+      } else {
+        r_node_poke_car(info->lower_root, target);
+        // If there is no parent x there is no operator precedence to
+        // fix so abort rotation
+        initialise_rotation_info(info);
+      }
+      return;
+    }
 
-    if (parent_node) {
-      r_node_poke_car(parent_node, target);
-    } else {
-      r_node_poke_car(info->lower_root, target);
-      // If there is no parent x there is no operator precedence to
-      // fix so abort recursion
-      initialise_rotation_info(info);
+    // Only expand RHS if not the upper pivot because there might be
+    // consecutive rotations needed. The upper pivot's RHS will be
+    // expanded after the current rotation is complete.
+    if (x != info->upper_pivot) {
+      r_node_poke_car(rhs_node, call_interp(r_node_car(rhs_node), env));
     }
-    return;
-  }
 
-  // Only expand RHS if not the upper pivot because there might be
-  // consecutive rotations needed. The upper pivot's RHS will be
-  // expanded after the current rotation is complete.
-  if (x != info->upper_pivot) {
-    r_node_poke_car(rhs_node, call_interp(r_node_car(rhs_node), env));
-  }
+    sexp* lhs = r_node_car(lhs_node);
+    enum r_operator lhs_op = r_which_operator(lhs);
+    if (!op_needs_fixup(lhs_op)) {
+      if (!info->lower_pivot) {
+        info->lower_pivot = x;
+      }
 
-  sexp* lhs = r_node_car(lhs_node);
-  enum r_operator lhs_op = r_which_operator(lhs);
-  if (!op_needs_fixup(lhs_op)) {
-    if (!info->lower_pivot) {
-      info->lower_pivot = x;
+      sexp* target = r_eval(lhs, env);
+      r_node_poke_cadr(x, target);
+
+      // Stop climbing as we found both target and lower pivot
+      return;
     }
 
-    sexp* target = r_eval(lhs, env);
-    r_node_poke_cadr(x, target);
+    if (!r_lhs_op_has_precedence(info->upper_pivot_op, lhs_op)) {
+      info->lower_pivot = x;
+    }
 
-    // Stop recursion as we found both target and lower pivot
-    return;
+    // Climb the LHS
+    x = lhs;
+    parent_node = lhs_node;
   }
+}
+
+
+/**
+ * struct fixup_path - Problematic operations climbed from the root
+ *
+ * @p_ops: Array of &struct fixup_root_candidate ordered from the root
+ *   downwards. These operations might be the upper root around which
+ *   to rotate. Allocated on first use.
+ * @pivot_parent: The operation of which the upper pivot was found to
+ *   be the RHS.
+ * @n_protect: Number of objects to unprotect once the expansion is
+ *   complete.
+ */
+struct fixup_root_candidate {
+  sexp* op;
+  sexp* parent;
+};
+
+struct fixup_path {
+  struct r_dyn_array* p_ops;
+  sexp* pivot_parent;
+  int n_protect;
+};
 
-  if (!r_lhs_op_has_precedence(info->upper_pivot_op, lhs_op)) {
-    info->lower_pivot = x;
+static void fixup_path_push(struct fixup_path* p_path, sexp* op, sexp* parent) {
+  if (!p_path->p_ops) {
+    p_path->p_ops = r_new_dyn_array(sizeof(struct fixup_root_candidate), 16);
+    KEEP(p_path->p_ops->shelter);
+    ++p_path->n_protect;
   }
 
-  // Recurse
-  find_lower_pivot(lhs, lhs_node, env, info);
+  struct fixup_root_candidate candidate = { .op = op, .parent = parent };
+  r_arr_push_back(p_path->p_ops, &candidate);
 }
 
+static void fixup_path_truncate(struct fixup_path* p_path, r_ssize n) {
+  if (p_path->p_ops) {
+    p_path->p_ops->count = n;
+  }
+}
 
-// Defined below
-static void node_list_interp_fixup_rhs(sexp* rhs, sexp* rhs_node, sexp* parent,
-                                       sexp* env, struct ast_rotation_info* info);
+/**
+ * find_upper_root() - Find the upper root among the climbed operations
+ *
+ * The topmost operation that has precedence over the upper pivot is
+ * the upper root. Fill in &ast_rotation_info->upper_root and
+ * &ast_rotation_info->root_parent and return its position in the
+ * path, or -1 if there is none.
+ */
+static r_ssize find_upper_root(struct fixup_path* p_path, struct ast_rotation_info* info) {
+  if (!p_path->p_ops) {
+    return -1;
+  }
+
+  r_ssize n = p_path->p_ops->count;
+  for (r_ssize i = 0; i < n; ++i) {
+    const struct fixup_root_candidate* p_candidate = r_arr_ptr_const(p_path->p_ops, i);
+
+    if (r_lhs_op_has_precedence(r_which_operator(p_candidate->op), info->upper_pivot_op)) {
+      info->upper_root = p_candidate->op;
+      info->root_parent = p_candidate->parent;
+      return i;
+    }
+  }
+
+  return -1;
+}
 
 /**
- * node_list_interp_fixup() - Expansion for binary operators that might need fixup
+ * fixup_climb() - Expansion for binary operators that might need fixup
  *
  * @x A call to a binary operator whith problematic precedence
  *   (between prec(`!`) and prec(`!!`)).
- * @env The environment where to unquote the `!!` target.
  * @parent Needed to handle a mix of unary and binary operators
  *   supplied to the unquote operator, e.g. `!!-1 + 2`. This is the
  *   outer call of which `x` is an argument, or the C `NULL` if there
  *   is none.
+ * @env The environment where to unquote the `!!` target.
  * @info Information about the pivot, the root and the unquoted target.
- * @expand_lhs Whether to expand the LHS. In some cases (e.g. after a
- *   rotation) it is not necessary to expand the LHS as it was already
- *   visited.
+ * @p_path The problematic operations climbed so far.
+ * @expand_lhs Whether to expand the LHS of @x. In some cases (e.g.
+ *   after a rotation) it is not necessary to expand the LHS as it was
+ *   already visited.
+ *
+ * Climb through the RHS's of problematic operations, expanding their
+ * LHS's on the way and recording them in @p_path. Stop at the first
+ * RHS that is a `!!` call, find the pivots and unquote the target.
  */
-static sexp* node_list_interp_fixup(sexp* x, sexp* parent, sexp* env,
-                                    struct ast_rotation_info* info,
-                                    bool expand_lhs) {
-  sexp* lhs_node = r_node_cdr(x);
-  sexp* lhs = r_node_car(lhs_node);
-
-  // If there's a unary `+` or `-` on the way recurse on its RHS
-  if (is_unary_plusminus(x)) {
-    node_list_interp_fixup_rhs(lhs, lhs_node, parent, env, info);
-    return x;
-  }
+static void fixup_climb(sexp* x, sexp* parent, sexp* env,
+                        struct ast_rotation_info* info,
+                        struct fixup_path* p_path,
+                        bool expand_lhs) {
+  sexp* op = x;
+
+  while (true) {
+    sexp* rhs_node;
+
+    // If there's a unary `+` or `-` on the way climb its RHS
+    if (is_unary_plusminus(op)) {
+      rhs_node = r_node_cdr(op);
+    } else {
+      if (expand_lhs) {
+        // Expand the LHS normally, it never needs changes in the AST
+        sexp* lhs_node = r_node_cdr(op);
+        r_node_poke_car(lhs_node, call_interp(r_node_car(lhs_node), env));
+      }
+      rhs_node = r_node_cddr(op);
+      parent = op;
+    }
 
+    // Happens with constructed calls like `/`(1)
+    if (rhs_node == r_null) {
+      return;
+    }
 
-  sexp* rhs_node = r_node_cddr(x);
-  sexp* rhs = r_node_car(rhs_node);
+    sexp* rhs = r_node_car(rhs_node);
 
-  if (expand_lhs) {
-    // Expand the LHS normally, it never needs changes in the AST
-    r_node_poke_car(lhs_node, call_interp(r_node_car(lhs_node), env));
-  }
+    // An upper pivot is an operand of a !! call that is a binary
+    // operation whose precedence is problematic (between prec(`!`)
+    // and prec(`!!`))
+    find_upper_pivot(rhs, info);
+    if (info->upper_pivot) {
+      info->lower_root = rhs_node;
+      p_path->pivot_parent = parent;
 
-  node_list_interp_fixup_rhs(rhs, rhs_node, x, env, info);
-  return x;
+      // There might be a lower pivot, so we need to find it. Also
+      // find the target of unquoting (leftmost leaf whose predecence
+      // is greater than prec(`!!`)) and unquote it.
+      find_lower_pivot(info->upper_pivot, NULL, env, info);
+
+      if (info->upper_pivot) {
+        // Reattach the RHS to the upper pivot stripped of its !! call
+        // in case there is no rotation around the lower root
+        r_node_poke_car(rhs_node, info->upper_pivot);
+      }
+
+      return;
+    }
+
+    // RHS is not a binary operation that might need changes in the
+    // AST so expand it as usual
+    if (!is_problematic_op(rhs)) {
+      r_node_poke_car(rhs_node, call_interp(rhs, env));
+      return;
+    }
+
+    // If `rhs` is an operator that might be involved in a rotation
+    // keep climbing
+    fixup_path_push(p_path, rhs, parent);
+    op = rhs;
+    expand_lhs = true;
+  }
 }
 
 /**
- * node_list_interp_fixup_rhs() - Expansion for binary operators that might need fixup
+ * fixup_expand() - Expand a problematic operation and rotate pivots
  *
- * @rhs: The right-hand side argument of an operator with problematic
- *   precedence.
- * @rhs_node: Parent node of RHS. If `rhs` is a `!!` call, we reattach
- *   the `!!` operand to its parent node `rhs_node`.
- * @parent: See node_list_interp_fixup().
+ * @x: A problematic operation, the root.
  * @env: The unquoting environment.
- * @info: See &struct ast_rotation_info.
+ * @expand_lhs: Whether to expand the LHS of @x.
+ *
+ * Climb the RHS's from the root until a pivot is found, then rotate
+ * it if needed:
+ *
+ * - If the root has precedence over the upper pivot, rotate around
+ *   the root. The upper pivot becomes the new root.
+ *
+ * - Otherwise if one of the climbed operations has precedence over
+ *   the upper pivot, this is the upper root around which to rotate.
+ *   The upper pivot takes its place in the path.
+ *
+ * - Otherwise no rotation is needed because the effect of `!` on the
+ *   AST corresponds to the implicit grouping (e.g. with `1 + !!2 * 3`).
+ *
+ * In all cases, the climb resumes from the RHS of the upper pivot
+ * whose LHS has already been expanded. The operations above the upper
+ * pivot are kept in the path rather than climbed again, so that each
+ * operation is visited once and a series of `!!` calls is expanded in
+ * linear time.
  */
-static void node_list_interp_fixup_rhs(sexp* rhs, sexp* rhs_node, sexp* parent,
-                                       sexp* env, struct ast_rotation_info* info) {
-  // Happens with constructed calls like `/`(1)
-  if (rhs_node == r_null) {
-    return;
-  }
+static sexp* fixup_expand(sexp* x, sexp* env, bool expand_lhs) {
+  struct ast_rotation_info info;
+  initialise_rotation_info(&info);
 
-  // An upper pivot is an operand of a !! call that is a binary
-  // operation whose precedence is problematic (between prec(`!`) and
-  // prec(`!!`))
-  find_upper_pivot(rhs, info);
-  if (info->upper_pivot) {
-    info->lower_root = rhs_node;
+  struct fixup_path path = { .p_ops = NULL, .pivot_parent = NULL, .n_protect = 0 };
 
-    // There might be a lower pivot, so we need to find it. Also find
-    // the target of unquoting (leftmost leaf whose predecence is
-    // greater than prec(`!!`)) and unquote it.
-    find_lower_pivot(info->upper_pivot, NULL, env, info);
+  fixup_climb(x, NULL, env, &info, &path, expand_lhs);
 
-    if (info->upper_pivot) {
-      // Reattach the RHS to the upper pivot stripped of its !! call
-      // in case there is no rotation around the lower root
-      r_node_poke_car(rhs_node, info->upper_pivot);
-    }
+  while (info.upper_pivot_op != R_OP_NONE) {
+    sexp* pivot = info.upper_pivot;
+    r_ssize i_root = find_upper_root(&path, &info);
 
-    return;
-  }
+    // Rotate if `x` is the upper root
+    if (r_lhs_op_has_precedence(r_which_operator(x), info.upper_pivot_op)) {
+      // Swap the lower root's RHS with the lower pivot's LHS
+      r_node_poke_car(info.lower_root, r_node_cadr(info.lower_pivot));
+      r_node_poke_cadr(info.lower_pivot, x);
 
-  // If `rhs` is an operator that might be involved in a rotation
-  // recurse with the fixup version
-  if (is_problematic_op(rhs)) {
-    node_list_interp_fixup(rhs, parent, env, info, true);
+      // After rotation the upper pivot is the new root
+      x = pivot;
+      fixup_path_truncate(&path, 0);
 
-    // This might the upper root around which to rotate
-    if (info->upper_pivot_op
-        && r_lhs_op_has_precedence(r_which_operator(rhs), info->upper_pivot_op)) {
-      info->upper_root = rhs;
-      info->root_parent = parent;
+      initialise_rotation_info(&info);
+      fixup_climb(x, NULL, env, &info, &path, false);
+      continue;
     }
 
-    return;
+    sexp* pivot_parent;
+    if (i_root >= 0) {
+      r_node_poke_car(info.lower_root, r_node_cadr(info.lower_pivot));
+      r_node_poke_cadr(info.lower_pivot, info.upper_root);
+      r_node_poke_car(r_node_cddr(info.root_parent), pivot);
+
+      // The upper root and the operations below it are now part of
+      // the pivot's LHS
+      fixup_path_truncate(&path, i_root);
+      pivot_parent = info.root_parent;
+    } else {
+      // No rotation needed
+      pivot_parent = path.pivot_parent;
+    }
+
+    fixup_path_push(&path, pivot, pivot_parent);
+
+    // Reinitialise the `ast_rotation_info` on the stack in order to
+    // reuse it for the next pivot
+    initialise_rotation_info(&info);
+    fixup_climb(pivot, pivot_parent, env, &info, &path, false);
   }
 
-  // RHS is not a binary operation that might need changes in the AST
-  // so expand it as usual
-  r_node_poke_car(rhs_node, call_interp(rhs, env));
+  FREE(path.n_protect);
+  return x;
 }
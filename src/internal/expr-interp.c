@@ -2,6 +2,7 @@
 #include "expr-interp.h"
 #include "expr-interp-rotate.h"
 #include "utils.h"
+#include "vec.h"
 
 
 struct expansion_info which_bang_op(sexp* second, struct expansion_info info);
@@ -310,7 +311,6 @@ static sexp* curly_curly(struct expansion_info info, sexp* env) {
 
 // Defined below
 static sexp* call_list_interp(sexp* x, sexp* env);
-static sexp* node_list_interp(sexp* x, sexp* env);
 static void call_maybe_poke_string_head(sexp* call);
 
 sexp* call_interp(sexp* x, sexp* env)  {
@@ -328,9 +328,7 @@ sexp* call_interp_impl(sexp* x, sexp* env, struct expansion_info info) {
     if (r_typeof(x) != r_type_call) {
       return x;
     } else {
-      sexp* out = call_list_interp(x, env);
-      call_maybe_poke_string_head(out);
-      return out;
+      return call_list_interp(x, env);
     }
   case OP_EXPAND_UQ:
     return bang_bang(info, env);
@@ -384,43 +382,270 @@ static void call_maybe_poke_string_head(sexp* call) {
   r_node_poke_car(call, r_sym(r_chr_get_c_string(head, 0)));
 }
 
+/**
+ * struct interp_frame - Pending expansion of a call
+ *
+ * @call: The call whose head and arguments are being expanded.
+ * @prev: The node preceding @node, needed to splice `!!!` arguments.
+ * @node: The next node to expand. The first node is @call itself
+ *   since its CAR is the head of the call.
+ *
+ * Calls are expanded iteratively with an explicit stack of frames so
+ * that the depth of expressions is bounded by memory rather than by
+ * the C stack. Frames are expanded in depth-first order, from left to
+ * right, so that injected expressions are evaluated in the same order
+ * as with a recursive traversal.
+ */
+struct interp_frame {
+  sexp* call;
+  sexp* prev;
+  sexp* node;
+};
+
 static sexp* call_list_interp(sexp* x, sexp* env) {
-  r_node_poke_car(x, call_interp(r_node_car(x), env));
-  r_node_poke_cdr(x, node_list_interp(r_node_cdr(x), env));
-  return x;
-}
-static sexp* node_list_interp(sexp* node, sexp* env) {
-  sexp* prev = KEEP(r_new_node(r_null, node));
-  sexp* out = prev;
+  struct r_dyn_array* p_stack = r_new_dyn_array(sizeof(struct interp_frame), 16);
+  KEEP(p_stack->shelter);
+
+  struct interp_frame frame = { .call = x, .prev = r_null, .node = x };
+  r_arr_push_back(p_stack, &frame);
+
+  while (p_stack->count) {
+    struct interp_frame* p_frame = r_arr_ptr_back(p_stack);
+    sexp* node = p_frame->node;
+
+    if (node == r_null) {
+      call_maybe_poke_string_head(p_frame->call);
+      r_arr_pop_back(p_stack);
+      continue;
+    }
 
-  while (node != r_null) {
     sexp* arg = r_node_car(node);
     struct expansion_info info = which_expansion_op(arg, false);
 
-    if (info.op == OP_EXPAND_UQS) {
-      node = big_bang(info.operand, env, prev, node);
+    // Splicing is only supported in arguments. In the head of the
+    // call, `call_interp_impl()` throws an error.
+    if (info.op == OP_EXPAND_UQS && node != p_frame->call) {
+      node = big_bang(info.operand, env, p_frame->prev, node);
+    } else if (info.op == OP_EXPAND_NONE && r_typeof(arg) == r_type_call) {
+      // Expand the argument in place before moving on to the next one
+      p_frame->prev = node;
+      p_frame->node = r_node_cdr(node);
+
+      frame = (struct interp_frame) { .call = arg, .prev = r_null, .node = arg };
+      r_arr_push_back(p_stack, &frame);
+      continue;
     } else {
       r_node_poke_car(node, call_interp_impl(arg, env, info));
     }
 
-    prev = node;
-    node = r_node_cdr(node);
+    p_frame->prev = node;
+    p_frame->node = r_node_cdr(node);
+  }
+
+  FREE(1);
+  return x;
+}
+
+
+/**
+ * call_tree_copy() - Copy the call tree of an expression
+ *
+ * Interpolation modifies calls and argument lists in place. Only
+ * these nodes need to be copied, the leaves of the tree are shared
+ * with the original expression. The tree is traversed with an
+ * explicit stack so that deep expressions can be copied without
+ * overflowing the C stack.
+ */
+static inline
+bool is_tree_node(sexp* x) {
+  switch (r_typeof(x)) {
+  case r_type_call:
+  case r_type_pairlist:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static
+sexp* node_shallow_copy(sexp* x) {
+  sexp* out;
+  if (r_typeof(x) == r_type_call) {
+    out = KEEP(r_new_call(r_node_car(x), r_node_cdr(x)));
+  } else {
+    out = KEEP(r_new_node(r_node_car(x), r_node_cdr(x)));
+  }
+
+  r_node_poke_tag(out, r_node_tag(x));
+
+  sexp* attrib = r_attrib(x);
+  if (attrib != r_null) {
+    r_poke_attrib(out, r_copy(attrib));
+    SET_OBJECT(out, OBJECT(x));
+  }
+
+  FREE(1);
+  return out;
+}
+
+sexp* call_tree_copy(sexp* x) {
+  if (!is_tree_node(x)) {
+    return x;
+  }
+
+  sexp* out = KEEP(node_shallow_copy(x));
+
+  struct r_dyn_array* p_stack = r_new_dyn_array(sizeof(sexp*), 16);
+  KEEP(p_stack->shelter);
+  r_arr_push_back(p_stack, &out);
+
+  while (p_stack->count) {
+    sexp* node = *((sexp**) r_arr_ptr_back(p_stack));
+    r_arr_pop_back(p_stack);
+
+    while (true) {
+      sexp* car = r_node_car(node);
+
+      if (is_tree_node(car)) {
+        car = node_shallow_copy(car);
+        r_node_poke_car(node, car);
+        r_arr_push_back(p_stack, &car);
+      } else if (r_is_vector(car, -1)) {
+        // The leaf is now referenced by both trees
+        r_mark_shared(car);
+      }
+
+      sexp* cdr = r_node_cdr(node);
+      if (!is_tree_node(cdr)) {
+        break;
+      }
+
+      cdr = node_shallow_copy(cdr);
+      r_node_poke_cdr(node, cdr);
+      node = cdr;
+    }
+  }
+
+  FREE(2);
+  return out;
+}
+
+
+/**
+ * Pre-scan for injection operators. Trees that don't contain any
+ * operator don't need to be copied and interpolated. Operators are
+ * detected by comparing symbol pointers so the scan doesn't need any
+ * string comparisons. The scan is conservative: it may detect an
+ * operator that interpolation wouldn't expand, e.g. a `!!` symbol in
+ * argument position, in which case the expression is interpolated
+ * as usual.
+ *
+ * The verdict is not memoised: calls can be modified in place (e.g.
+ * with `node_poke_car()`) and a cache would have to retain them.
+ */
+
+static sexp* bang_sym = NULL;
+static sexp* bang_bang_sym = NULL;
+static sexp* bang_bang_bang_sym = NULL;
+static sexp* curly_sym = NULL;
+static sexp* uq_sym = NULL;
+static sexp* uqs_sym = NULL;
+static sexp* brackets2_sym = NULL;
+
+static inline
+bool is_call_of(sexp* x, sexp* head) {
+  return r_typeof(x) == r_type_call && r_node_car(x) == head;
+}
+
+static
+bool is_injection_op(sexp* x) {
+  switch (r_typeof(x)) {
+  case r_type_symbol:
+    return
+      x == bang_bang_sym ||
+      x == bang_bang_bang_sym ||
+      x == uq_sym ||
+      x == uqs_sym;
+  case r_type_call:
+    break;
+  default:
+    return false;
+  }
+
+  sexp* head = r_node_car(x);
+  sexp* first = r_node_cadr(x);
+
+  // `!!`, `!!!`, and `{{`
+  if (head == bang_sym && is_call_of(first, bang_sym)) {
+    return true;
+  }
+  if (head == curly_sym && is_call_of(first, curly_sym)) {
+    return true;
+  }
+  if (head == brackets2_sym && first == dot_data_sym) {
+    return true;
+  }
+
+  // String heads are converted to symbols by `call_interp()`
+  return r_typeof(head) == r_type_character;
+}
+
+// The tree is traversed with an explicit stack to support very deep
+// expressions
+static
+bool has_injection_op(sexp* x) {
+  struct r_dyn_array* p_stack = r_new_dyn_array(sizeof(sexp*), 16);
+  KEEP(p_stack->shelter);
+  r_arr_push_back(p_stack, &x);
+
+  bool out = false;
+
+  while (p_stack->count) {
+    x = *((sexp**) r_arr_ptr_back(p_stack));
+    r_arr_pop_back(p_stack);
+
+    if (is_injection_op(x)) {
+      out = true;
+      break;
+    }
+    if (r_typeof(x) != r_type_call) {
+      continue;
+    }
+
+    for (sexp* node = x; node != r_null; node = r_node_cdr(node)) {
+      sexp* car = r_node_car(node);
+
+      switch (r_typeof(car)) {
+      case r_type_symbol:
+      case r_type_call:
+        r_arr_push_back(p_stack, &car);
+        break;
+      default:
+        break;
+      }
+    }
   }
 
   FREE(1);
-  return r_node_cdr(out);
+  return out;
+}
+
+bool call_needs_interp(sexp* x) {
+  if (r_typeof(x) != r_type_call) {
+    return false;
+  }
+  return has_injection_op(x);
 }
 
 sexp* rlang_interp(sexp* x, sexp* env) {
   if (!r_is_environment(env)) {
     r_abort("`env` must be an environment");
   }
-  if (r_typeof(x) != r_type_call) {
+  if (!call_needs_interp(x)) {
     return x;
   }
 
-  // FIXME: Only duplicate the call tree, not the leaves
-  x = KEEP(r_copy(x));
+  x = KEEP(call_tree_copy(x));
   x = call_interp(x, env);
 
   FREE(1);
@@ -430,4 +655,12 @@ sexp* rlang_interp(sexp* x, sexp* env) {
 
 void rlang_init_expr_interp() {
   dot_data_sym = r_sym(".data");
+
+  bang_sym = r_sym("!");
+  bang_bang_sym = r_sym("!!");
+  bang_bang_bang_sym = r_sym("!!!");
+  curly_sym = r_sym("{");
+  uq_sym = r_sym("UQ");
+  uqs_sym = r_sym("UQS");
+  brackets2_sym = r_sym("[[");
 }
@@ -61,6 +61,9 @@ struct expansion_info is_big_bang_op(sexp* x);
 
 sexp* big_bang_coerce(sexp* expr);
 
+bool call_needs_interp(sexp* x);
+sexp* call_tree_copy(sexp* x);
+
 sexp* rlang_interp(sexp* x, sexp* env);
 sexp* call_interp(sexp* x, sexp* env);
 sexp* call_interp_impl(sexp* x, sexp* env, struct expansion_info info);
@@ -0,0 +1,285 @@
+#include <rlang.h>
+#include "internal.h"
+
+/**
+ * Expression templates are expressions containing holes, symbols
+ * prefixed with a single dot such as `.x`. The paths to the holes are
+ * recorded once when the template is created. Filling a template
+ * copies only the calls along these paths and pokes the values in
+ * place of the holes, so the cost of filling scales with the number
+ * of holes rather than with the size of the expression.
+ *
+ * A path is an integer vector of node positions. At each level,
+ * position 0 is the head of the call and position `i` its `i`th
+ * argument. Paths are recorded in depth-first order, which is also
+ * lexicographic order. Consecutive paths share their calls up to the
+ * length of their common prefix.
+ */
+
+#define TEMPLATE_N 4
+#define TEMPLATE_EXPR 0
+#define TEMPLATE_NAMES 1
+#define TEMPLATE_HOLES 2
+#define TEMPLATE_PATHS 3
+
+struct template_info {
+  struct r_dyn_array* p_path;
+  struct r_dyn_array* p_names;
+  struct r_dyn_array* p_holes;
+  struct r_dyn_array* p_paths;
+};
+
+static sexp* template_names = NULL;
+static sexp* template_class = NULL;
+
+static void template_scan(sexp* x, struct template_info* p_info);
+
+
+sexp* rlang_expr_template(sexp* expr) {
+  sexp* shelter = KEEP(r_new_list(4));
+
+  struct template_info info;
+
+  info.p_path = r_new_dyn_vector(r_type_integer, 8);
+  r_list_poke(shelter, 0, info.p_path->shelter);
+
+  info.p_names = r_new_dyn_vector(r_type_character, 4);
+  r_list_poke(shelter, 1, info.p_names->shelter);
+
+  info.p_holes = r_new_dyn_vector(r_type_integer, 4);
+  r_list_poke(shelter, 2, info.p_holes->shelter);
+
+  info.p_paths = r_new_dyn_vector(r_type_list, 4);
+  r_list_poke(shelter, 3, info.p_paths->shelter);
+
+  template_scan(expr, &info);
+
+  sexp* out = KEEP(r_new_list(TEMPLATE_N));
+  r_list_poke(out, TEMPLATE_EXPR, expr);
+  r_list_poke(out, TEMPLATE_NAMES, r_arr_unwrap(info.p_names));
+  r_list_poke(out, TEMPLATE_HOLES, r_arr_unwrap(info.p_holes));
+  r_list_poke(out, TEMPLATE_PATHS, r_arr_unwrap(info.p_paths));
+
+  r_attrib_poke_names(out, template_names);
+  r_attrib_poke_class(out, template_class);
+
+  r_mark_shared(expr);
+
+  FREE(2);
+  return out;
+}
+
+static
+bool is_hole(sexp* x) {
+  if (r_typeof(x) != r_type_symbol) {
+    return false;
+  }
+
+  // Excludes `.`, `...`, and `..1`
+  const char* name = r_sym_c_string(x);
+  return name[0] == '.' && name[1] != '\0' && name[1] != '.';
+}
+
+static
+int template_hole_index(struct template_info* p_info, sexp* sym) {
+  // Strip the dot prefix
+  sexp* name = KEEP(r_str(r_sym_c_string(sym) + 1));
+
+  struct r_dyn_array* p_names = p_info->p_names;
+  sexp* const * v_names = r_chr_deref_const(p_names->data);
+
+  for (r_ssize i = 0; i < p_names->count; ++i) {
+    if (v_names[i] == name) {
+      FREE(1);
+      return i;
+    }
+  }
+
+  r_arr_push_back(p_names, name);
+
+  FREE(1);
+  return p_names->count - 1;
+}
+
+static
+void template_push_hole(struct template_info* p_info, sexp* sym) {
+  r_int_push_back(p_info->p_holes, template_hole_index(p_info, sym));
+
+  struct r_dyn_array* p_path = p_info->p_path;
+  r_ssize n = p_path->count;
+
+  sexp* path = KEEP(r_new_integer(n));
+  memcpy(r_int_deref(path), r_arr_ptr_front(p_path), n * sizeof(int));
+  r_arr_push_back(p_info->p_paths, path);
+
+  FREE(1);
+}
+
+static
+void template_scan(sexp* x, struct template_info* p_info) {
+  switch (r_typeof(x)) {
+  case r_type_symbol:
+    if (is_hole(x)) {
+      template_push_hole(p_info, x);
+    }
+    return;
+  case r_type_call:
+  case r_type_pairlist:
+    break;
+  default:
+    return;
+  }
+
+  int i = 0;
+  for (sexp* node = x; node != r_null; node = r_node_cdr(node), ++i) {
+    r_int_push_back(p_info->p_path, i);
+    template_scan(r_node_car(node), p_info);
+    r_arr_pop_back(p_info->p_path);
+  }
+}
+
+
+static
+void check_template(sexp* x) {
+  if (r_typeof(x) != r_type_list ||
+      r_length(x) != TEMPLATE_N ||
+      !r_inherits(x, "rlang_expr_template")) {
+    r_abort("`template` must be an expression template.");
+  }
+}
+
+static inline
+sexp* node_at(sexp* x, int i) {
+  while (i--) {
+    x = r_node_cdr(x);
+  }
+  return x;
+}
+
+// Finds the value matching each hole name. Holes without a value are
+// left in the expression.
+static
+sexp* template_match_values(sexp* names, sexp* values) {
+  r_ssize n_names = r_length(names);
+  r_ssize n_values = r_length(values);
+
+  sexp* const * v_names = r_chr_deref_const(names);
+
+  sexp* value_names = r_names(values);
+  if (n_values && value_names == r_null) {
+    r_abort("Template values must be named.");
+  }
+
+  sexp* out = KEEP(r_new_integer(n_names));
+  int* v_out = r_int_deref(out);
+  for (r_ssize i = 0; i < n_names; ++i) {
+    v_out[i] = -1;
+  }
+
+  for (r_ssize i = 0; i < n_values; ++i) {
+    sexp* name = r_chr_get(value_names, i);
+    if (name == r_strs_empty || name == r_strs_na) {
+      r_abort("Template values must be named.");
+    }
+
+    r_ssize j = 0;
+    for (; j < n_names; ++j) {
+      if (v_names[j] == name) {
+        break;
+      }
+    }
+    if (j == n_names) {
+      r_abort("Template doesn't have a hole `.%s`.", r_str_c_string(name));
+    }
+
+    v_out[j] = i;
+  }
+
+  FREE(1);
+  return out;
+}
+
+sexp* rlang_template_fill(sexp* template, sexp* values) {
+  check_template(template);
+  if (r_typeof(values) != r_type_list) {
+    r_abort("`values` must be a list.");
+  }
+
+  sexp* expr = r_list_get(template, TEMPLATE_EXPR);
+  sexp* holes = r_list_get(template, TEMPLATE_HOLES);
+  sexp* paths = r_list_get(template, TEMPLATE_PATHS);
+
+  sexp* matches = KEEP(template_match_values(r_list_get(template, TEMPLATE_NAMES), values));
+  const int* v_matches = r_int_deref_const(matches);
+  const int* v_holes = r_int_deref_const(holes);
+
+  sexp* out = expr;
+  r_keep_t out_i;
+  KEEP_HERE(out, &out_i);
+
+  // Path of the last filled hole. Its calls have already been copied.
+  sexp* prev = r_null;
+
+  r_ssize n = r_length(holes);
+  for (r_ssize i = 0; i < n; ++i) {
+    int match = v_matches[v_holes[i]];
+    if (match < 0) {
+      continue;
+    }
+
+    sexp* value = r_list_get(values, match);
+    r_mark_shared(value);
+
+    sexp* path = r_list_get(paths, i);
+    r_ssize depth = r_length(path);
+    const int* v_path = r_int_deref_const(path);
+
+    if (depth == 0) {
+      out = value;
+      KEEP_AT(out, out_i);
+      continue;
+    }
+
+    // Length of the prefix shared with the previous path
+    r_ssize n_prev = r_length(prev);
+    r_ssize n_shared = 0;
+    if (prev != r_null) {
+      const int* v_prev = r_int_deref_const(prev);
+      while (n_shared < n_prev && n_shared < depth && v_prev[n_shared] == v_path[n_shared]) {
+        ++n_shared;
+      }
+    } else {
+      out = r_clone(expr);
+      KEEP_AT(out, out_i);
+    }
+
+    sexp* call = out;
+    for (r_ssize j = 0; j < depth - 1; ++j) {
+      sexp* node = node_at(call, v_path[j]);
+      call = r_node_car(node);
+
+      if (j >= n_shared) {
+        call = r_clone(call);
+        r_node_poke_car(node, call);
+      }
+    }
+
+    r_node_poke_car(node_at(call, v_path[depth - 1]), value);
+    prev = path;
+  }
+
+  FREE(2);
+  return out;
+}
+
+
+void rlang_init_expr_template() {
+  const char* names[TEMPLATE_N] = { "expr", "names", "holes", "paths" };
+  template_names = r_chr_n(names, TEMPLATE_N);
+  r_preserve(template_names);
+  r_mark_shared(template_names);
+
+  template_class = r_chr("rlang_expr_template");
+  r_preserve(template_class);
+  r_mark_shared(template_class);
+}
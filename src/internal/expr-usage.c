@@ -0,0 +1,328 @@
+#include <rlang.h>
+#include "internal.h"
+
+/**
+ * Static analysis of the symbols an expression might refer to. This
+ * is used to find out which columns of a data frame an expression
+ * might need before creating a data mask, so that backends can prune
+ * the columns they materialise.
+ *
+ * The analysis is conservative: it may report symbols that are not
+ * columns (e.g. local variables) but should never miss a static
+ * column reference. References that can't be determined statically,
+ * such as `.data[[var]]` or `get("x")`, set the `dynamic` flag. So
+ * do calls evaluating code in other environments such as `with()` or
+ * `do.call()`, tidyselect helpers such as `everything()` or
+ * `across()` that select columns without naming them, and `.` inside
+ * formulas since it stands for all columns in model formulas like
+ * `y ~ .`.
+ */
+
+struct usage_info {
+  struct r_dict* p_syms_seen;
+  struct r_dyn_array* p_syms;
+
+  struct r_dict* p_data_seen;
+  struct r_dyn_array* p_data;
+
+  bool dynamic;
+  int formula_depth;
+};
+
+static sexp* usage_dot_data_sym = NULL;
+static sexp* usage_dot_env_sym = NULL;
+static sexp* usage_dollar_sym = NULL;
+static sexp* usage_at_sym = NULL;
+static sexp* usage_brackets2_sym = NULL;
+static sexp* usage_quote_sym = NULL;
+static sexp* usage_dot_sym = NULL;
+
+#define USAGE_DYNAMIC_N 35
+static const char* usage_dynamic_names[USAGE_DYNAMIC_N] = {
+  // Environment lookups and evaluation
+  "get", "get0", "mget", "exists", "assign", "eval", "evalq",
+  "eval_bare", "eval_tidy", "with", "within", "local", "do.call",
+  "environment", "parent.frame", "sys.frame", "sys.frames",
+  "sys.function", "ls", "objects",
+  // Tidyselect helpers and selecting verbs
+  "across", "if_any", "if_all", "c_across", "pick", "everything",
+  "last_col", "all_of", "any_of", "starts_with", "ends_with",
+  "contains", "matches", "num_range", "where"
+};
+static sexp* usage_dynamic_syms[USAGE_DYNAMIC_N];
+
+static void expr_usage(sexp* x, struct usage_info* p_info, sexp* scopes);
+
+
+sexp* rlang_expr_usage(sexp* x) {
+  sexp* shelter = KEEP(r_new_list(4));
+
+  struct usage_info info = {
+    .p_syms_seen = r_new_dict(32),
+    .p_data_seen = NULL,
+    .p_syms = NULL,
+    .p_data = NULL,
+    .dynamic = false,
+    .formula_depth = 0
+  };
+  r_list_poke(shelter, 0, info.p_syms_seen->shelter);
+
+  info.p_data_seen = r_new_dict(32);
+  r_list_poke(shelter, 1, info.p_data_seen->shelter);
+
+  info.p_syms = r_new_dyn_vector(r_type_character, 16);
+  r_list_poke(shelter, 2, info.p_syms->shelter);
+
+  info.p_data = r_new_dyn_vector(r_type_character, 16);
+  r_list_poke(shelter, 3, info.p_data->shelter);
+
+  switch (r_typeof(x)) {
+  case r_type_list:
+  case r_type_expression: {
+    r_ssize n = r_length(x);
+    for (r_ssize i = 0; i < n; ++i) {
+      expr_usage(r_list_get(x, i), &info, r_null);
+    }
+    break;
+  }
+  default:
+    expr_usage(x, &info, r_null);
+  }
+
+  sexp* out = KEEP(r_new_list(3));
+  r_list_poke(out, 0, r_arr_unwrap(info.p_syms));
+  r_list_poke(out, 1, r_arr_unwrap(info.p_data));
+  r_list_poke(out, 2, r_lgl(info.dynamic));
+
+  static const char* names[3] = { "symbols", "data", "dynamic" };
+  r_attrib_poke_names(out, r_chr_n(names, 3));
+
+  FREE(2);
+  return out;
+}
+
+
+static
+bool is_bound(sexp* sym, sexp* scopes) {
+  while (scopes != r_null) {
+    if (r_pairlist_find(r_node_car(scopes), sym) != r_null) {
+      return true;
+    }
+    scopes = r_node_cdr(scopes);
+  }
+  return false;
+}
+
+static
+void push_sym(struct usage_info* p_info, sexp* sym) {
+  if (r_dict_put(p_info->p_syms_seen, sym, r_null)) {
+    r_arr_push_back(p_info->p_syms, r_sym_string(sym));
+  }
+}
+static
+void push_data(struct usage_info* p_info, sexp* str) {
+  if (r_dict_put(p_info->p_data_seen, str, r_null)) {
+    r_arr_push_back(p_info->p_data, str);
+  }
+}
+
+static
+void sym_usage(sexp* x, struct usage_info* p_info, sexp* scopes) {
+  if (x == r_syms_missing || x == r_syms_dots || x == usage_dot_env_sym) {
+    return;
+  }
+  if (x == usage_dot_data_sym) {
+    // The whole pronoun escapes, e.g. `f(.data)`
+    p_info->dynamic = true;
+    return;
+  }
+  if (x == usage_dot_sym && p_info->formula_depth) {
+    // All columns, e.g. `y ~ .`. Also flagged in one-sided formulas
+    // since these may be model formulas as well, e.g. `~ . - x`.
+    p_info->dynamic = true;
+    return;
+  }
+  if (is_bound(x, scopes)) {
+    return;
+  }
+  push_sym(p_info, x);
+}
+
+static
+void args_usage(sexp* node, struct usage_info* p_info, sexp* scopes) {
+  while (node != r_null) {
+    expr_usage(r_node_car(node), p_info, scopes);
+    node = r_node_cdr(node);
+  }
+}
+
+// Symbols are literal names with `$` but are evaluated with `[[`
+static
+void data_subscript_usage(sexp* subscript,
+                          bool literal_sym,
+                          struct usage_info* p_info,
+                          sexp* scopes) {
+  if (literal_sym && r_typeof(subscript) == r_type_symbol) {
+    push_data(p_info, r_sym_string(subscript));
+    return;
+  }
+  if (r_is_string(subscript)) {
+    push_data(p_info, r_chr_get(subscript, 0));
+    return;
+  }
+
+  p_info->dynamic = true;
+  expr_usage(subscript, p_info, scopes);
+}
+
+// Formals and purrr-style lambda arguments are bound in a new scope
+static
+sexp* push_scope(sexp* bound, sexp* scopes) {
+  return r_new_node(bound, scopes);
+}
+
+static
+void fn_usage(sexp* x, struct usage_info* p_info, sexp* scopes) {
+  sexp* formals = r_node_cadr(x);
+  sexp* body = r_node_car(r_node_cddr(x));
+
+  scopes = KEEP(push_scope(formals, scopes));
+
+  // Default arguments are evaluated in the function environment
+  args_usage(formals, p_info, scopes);
+  expr_usage(body, p_info, scopes);
+
+  FREE(1);
+}
+
+static
+void formula_usage(sexp* x, struct usage_info* p_info, sexp* scopes) {
+  sexp* args = r_node_cdr(x);
+  ++p_info->formula_depth;
+
+  // Two-sided formulas are typically model formulas referring to
+  // columns. One-sided formulas may be lambdas whose arguments are
+  // not columns.
+  if (r_node_cdr(args) != r_null) {
+    args_usage(args, p_info, scopes);
+    --p_info->formula_depth;
+    return;
+  }
+
+  sexp* lambda_args = KEEP(r_pairlist3(r_null, r_null, r_null));
+  r_node_poke_tag(lambda_args, usage_dot_sym);
+  r_node_poke_tag(r_node_cdr(lambda_args), r_syms_dot_x);
+  r_node_poke_tag(r_node_cddr(lambda_args), r_syms_dot_y);
+
+  scopes = KEEP(push_scope(lambda_args, scopes));
+  args_usage(args, p_info, scopes);
+  --p_info->formula_depth;
+
+  FREE(2);
+}
+
+static
+bool is_dynamic_call(sexp* head) {
+  for (int i = 0; i < USAGE_DYNAMIC_N; ++i) {
+    if (head == usage_dynamic_syms[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static
+void call_usage(sexp* x, struct usage_info* p_info, sexp* scopes) {
+  if (rlang_is_quosure(x)) {
+    expr_usage(r_node_cadr(x), p_info, scopes);
+    return;
+  }
+
+  sexp* head = r_node_car(x);
+  sexp* args = r_node_cdr(x);
+
+  if (r_typeof(head) != r_type_symbol) {
+    expr_usage(head, p_info, scopes);
+    args_usage(args, p_info, scopes);
+    return;
+  }
+
+  if (head == usage_quote_sym ||
+      head == r_syms_namespace ||
+      head == r_syms_namespace3) {
+    return;
+  }
+
+  if (head == r_syms_function) {
+    fn_usage(x, p_info, scopes);
+    return;
+  }
+
+  if (head == r_syms_tilde) {
+    formula_usage(x, p_info, scopes);
+    return;
+  }
+
+  if (head == usage_dollar_sym || head == usage_at_sym) {
+    sexp* lhs = r_node_car(args);
+
+    if (lhs == usage_dot_data_sym) {
+      data_subscript_usage(r_node_cadr(args), true, p_info, scopes);
+    } else if (lhs != usage_dot_env_sym) {
+      // The right-hand side is a literal field name
+      expr_usage(lhs, p_info, scopes);
+    }
+    return;
+  }
+
+  if (head == usage_brackets2_sym) {
+    sexp* lhs = r_node_car(args);
+
+    if (lhs == usage_dot_data_sym) {
+      data_subscript_usage(r_node_cadr(args), false, p_info, scopes);
+      args_usage(r_node_cddr(args), p_info, scopes);
+      return;
+    }
+    if (lhs == usage_dot_env_sym) {
+      args_usage(r_node_cdr(args), p_info, scopes);
+      return;
+    }
+  }
+
+  if (is_dynamic_call(head)) {
+    p_info->dynamic = true;
+  }
+
+  // Function lookup skips non-function objects so the head can't
+  // refer to a column
+  args_usage(args, p_info, scopes);
+}
+
+static
+void expr_usage(sexp* x, struct usage_info* p_info, sexp* scopes) {
+  switch (r_typeof(x)) {
+  case r_type_symbol:
+    sym_usage(x, p_info, scopes);
+    return;
+  case r_type_call:
+    call_usage(x, p_info, scopes);
+    return;
+  default:
+    return;
+  }
+}
+
+
+void rlang_init_expr_usage() {
+  usage_dot_data_sym = r_sym(".data");
+  usage_dot_env_sym = r_sym(".env");
+  usage_dollar_sym = r_sym("$");
+  usage_at_sym = r_sym("@");
+  usage_brackets2_sym = r_sym("[[");
+  usage_quote_sym = r_sym("quote");
+  usage_dot_sym = r_sym(".");
+
+  for (int i = 0; i < USAGE_DYNAMIC_N; ++i) {
+    usage_dynamic_syms[i] = r_sym(usage_dynamic_names[i]);
+  }
+}
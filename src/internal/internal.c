@@ -5,6 +5,7 @@
 #include "arg.c"
 #include "attr.c"
 #include "call.c"
+#include "deparse.c"
 #include "dots.c"
 #include "env.c"
 #include "env-binding.c"
@@ -12,6 +13,8 @@
 #include "eval-tidy.c"
 #include "expr-interp.c"
 #include "expr-interp-rotate.c"
+#include "expr-template.c"
+#include "expr-usage.c"
 #include "fn.c"
 #include "hash.c"
 #include "nse-defuse.c"
@@ -20,9 +23,12 @@
 #include "replace-na.c"
 #include "squash.c"
 #include "sym-unescape.c"
+#include "trace.c"
 #include "utils.c"
 #include "vec.c"
+#include "vec-constant.c"
 #include "vec-raw.c"
+#include "vec-view.c"
 #include "weakref.c"
 
 
@@ -40,8 +46,14 @@ void rlang_init_internal(sexp* ns) {
   rlang_init_arg(ns);
   rlang_init_attr(ns);
   rlang_init_dots(ns);
+  init_parse(ns);
+  rlang_init_deparse();
   rlang_init_expr_interp();
+  rlang_init_expr_template();
+  rlang_init_expr_usage();
   rlang_init_eval_tidy();
+  rlang_init_trace();
+  rlang_init_vec_view_slice();
 
   rlang_zap = rlang_ns_get("zap!");
 
@@ -40,5 +40,8 @@ static inline sexp* rlang_dots(sexp* env) {
 
 sexp* rlang_replace_na(sexp* x, sexp* replacement);
 
+// From eval-tidy.c
+void rlang_data_pronoun_cache_invalidate(sexp* env);
+
 
 #endif
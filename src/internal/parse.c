@@ -52,301 +52,112 @@ const struct r_op_precedence r_ops_precedence[R_OP_MAX] = {
   [R_OP_BRACES]         = { .power = 200,  .assoc =  0,  .unary = false,  .delimited =  true }
 };
 
-enum r_operator r_which_operator(sexp* call) {
-  if (r_typeof(call) != r_type_call) {
-    return R_OP_NONE;
-  }
-
-  sexp* head = r_node_car(call);
-  if (r_typeof(head) != r_type_symbol) {
-    return R_OP_NONE;
-  }
-
-  const char* name = r_sym_c_string(head);
-  int len = strlen(name);
-  bool is_unary = r_node_cddr(call) == r_null;
-
-  switch (name[0]) {
-  case 'b':
-    if (strcmp(name, "break") == 0) {
-      return R_OP_BREAK;
-    } else {
-      goto none;
-    }
-  case 'f':
-    if (strcmp(name, "for") == 0) {
-      return R_OP_FOR;
-    } else if (strcmp(name, "function") == 0) {
-      return R_OP_FUNCTION;
-    } else {
-      goto none;
-    }
-  case 'i':
-    if (strcmp(name, "if") == 0) {
-      return R_OP_IF;
-    } else {
-      goto none;
-    }
-  case 'n':
-    if (strcmp(name, "next") == 0) {
-      return R_OP_NEXT;
-    } else {
-      goto none;
-    }
-  case 'r':
-    if (strcmp(name, "repeat") == 0) {
-      return R_OP_REPEAT;
-    } else {
-      goto none;
-    }
-  case 'w':
-    if (strcmp(name, "while") == 0) {
-      return R_OP_WHILE;
-    } else {
-      goto none;
-    }
+/**
+ * Operators are looked up by symbol pointer in an open-addressing
+ * hash table built by init_parse(). Symbols are interned so this
+ * avoids any string comparison. Operators that have a unary form
+ * store both variants, the unary/binary distinction is resolved
+ * after lookup. User-defined `%op%` operators are not interned in
+ * the table and are detected from the symbol name on a miss.
+ */
+
+#define OPS_TABLE_BITS 7
+#define OPS_TABLE_SIZE (1 << OPS_TABLE_BITS)
+
+struct op_entry {
+  sexp* sym;
+  enum r_operator op;
+  enum r_operator unary_op;
+};
 
-  case '?':
-    if (len == 1) {
-      if (is_unary) {
-        return R_OP_QUESTION_UNARY;
-      } else {
-        return R_OP_QUESTION;
-      }
-    } else {
-      goto none;
-    }
+static struct op_entry ops_table[OPS_TABLE_SIZE];
 
-  case '<':
-    switch (len) {
-    case 1:
-      return R_OP_LESS;
-    case 2:
-      switch (name[1]) {
-      case '-': return R_OP_ASSIGN1;
-      case '=': return R_OP_LESS_EQUAL;
-      default: goto none;
-      }
-    case 3:
-      if (name[1] == '<' && name[2] == '-') {
-        return R_OP_ASSIGN2;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
-    }
+static sexp* ops_strings = NULL;
 
-  case '>':
-    switch (len) {
-    case 1:
-      return R_OP_GREATER;
-    case 2:
-      if (name[1] == '=') {
-        return R_OP_GREATER_EQUAL;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
-    }
+static inline
+uint32_t ops_table_index(sexp* sym) {
+  // Fibonacci hashing of the symbol address
+  uint64_t hash = ((uint64_t) (uintptr_t) sym) * UINT64_C(0x9E3779B97F4A7C15);
+  return hash >> (64 - OPS_TABLE_BITS);
+}
 
-  case '=':
-    switch (len) {
-    case 1:
-      return R_OP_ASSIGN_EQUAL;
-    case 2:
-      if (name[1] == '=') {
-        return R_OP_EQUAL;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
-    }
+static
+const struct op_entry* ops_table_find(sexp* sym) {
+  uint32_t i = ops_table_index(sym);
 
-  case ':':
-    switch (len) {
-    case 1:
-      return R_OP_COLON1;
-    case 2:
-      switch (name[1]) {
-      case '=': return R_OP_COLON_EQUAL;
-      case ':': return R_OP_COLON2;
-      default: goto none;
-      }
-    case 3:
-      if (name[1] == ':' && name[2] == ':') {
-        return R_OP_COLON3;
-      } else {
-        goto none;
-      }
-    default: goto none;
-    }
+  while (true) {
+    const struct op_entry* p_entry = ops_table + i;
 
-  case '~':
-    if (len == 1) {
-      if (is_unary) {
-        return R_OP_TILDE_UNARY;
-      } else {
-        return R_OP_TILDE;
-      }
-    } else {
-      goto none;
+    if (p_entry->sym == sym) {
+      return p_entry;
     }
-
-  case '|':
-    switch (len) {
-    case 1:
-      return R_OP_OR1;
-    case 2:
-      if (name[1] == '|') {
-        return R_OP_OR2;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
+    if (p_entry->sym == NULL) {
+      return NULL;
     }
 
-  case '&':
-    switch (len) {
-    case 1:
-      return R_OP_AND1;
-    case 2:
-      if (name[1] == '&') {
-        return R_OP_AND2;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
-    }
+    i = (i + 1) & (OPS_TABLE_SIZE - 1);
+  }
+}
 
-  case '!':
-    switch (len) {
-    case 1:
-      return R_OP_BANG1;
-    case 2:
-      switch (name[1]) {
-      case '!': return R_OP_BANG2;
-      case '=': return R_OP_NOT_EQUAL;
-      default: goto none;
-      }
-    case 3:
-      if (name[1] == '!' && name[2] == '!') {
-        return R_OP_BANG3;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
-    }
+static
+void ops_table_add(const char* name, enum r_operator op, enum r_operator unary_op) {
+  sexp* sym = r_sym(name);
+  uint32_t i = ops_table_index(sym);
 
-  case '+':
-    if (len == 1) {
-      if (is_unary) {
-        return R_OP_PLUS_UNARY;
-      } else {
-        return R_OP_PLUS;
-      }
-    } else {
-      goto none;
+  while (ops_table[i].sym != NULL) {
+    if (ops_table[i].sym == sym) {
+      r_abort("Internal error: Operator `%s` is already in the table", name);
     }
+    i = (i + 1) & (OPS_TABLE_SIZE - 1);
+  }
 
-  case '-':
-    if (len == 1) {
-      if (is_unary) {
-        return R_OP_MINUS_UNARY;
-      } else {
-        return R_OP_MINUS;
-      }
-    } else {
-      goto none;
-    }
+  ops_table[i] = (struct op_entry) { .sym = sym, .op = op, .unary_op = unary_op };
+}
 
-  case '*':
-    if (len == 1) {
-      return R_OP_TIMES;
-    } else {
-      goto none;
-    }
+// User-defined operators like `%in%`
+static
+enum r_operator which_special_operator(sexp* sym) {
+  const char* name = r_sym_c_string(sym);
+  if (name[0] != '%') {
+    return R_OP_NONE;
+  }
 
-  case '/':
-    if (len == 1) {
-      return R_OP_RATIO;
-    } else {
-      goto none;
-    }
+  size_t len = strlen(name);
+  if (len > 2 && name[len - 1] == '%') {
+    return R_OP_SPECIAL;
+  } else {
+    return R_OP_NONE;
+  }
+}
 
-  case '%':
-    switch (len) {
-    case 1:
-      goto none;
-    case 2:
-      if (name[1] == '%') {
-        return R_OP_MODULO;
-      } else {
-        goto none;
-      }
-    default:
-      if (name[len - 1] == '%') {
-        return R_OP_SPECIAL;
-      } else {
-        goto none;
-      }
-    }
+enum r_operator r_which_operator(sexp* call) {
+  if (r_typeof(call) != r_type_call) {
+    return R_OP_NONE;
+  }
 
-  case '^':
-    if (len == 1) {
-      return R_OP_HAT;
-    } else {
-      goto none;
-    }
-  case '$':
-    if (len == 1) {
-      return R_OP_DOLLAR;
-    } else {
-      goto none;
-    }
-  case '@':
-    if (len == 1) {
-      return R_OP_AT;
-    } else {
-      goto none;
-    }
-  case '(':
-    if (len == 1) {
-      return R_OP_PARENTHESES;
-    } else {
-      goto none;
-    }
+  sexp* head = r_node_car(call);
+  if (r_typeof(head) != r_type_symbol) {
+    return R_OP_NONE;
+  }
 
-  case '[':
-    switch (len) {
-    case 1:
-      return R_OP_BRACKETS1;
-    case 2:
-      if (name[1] == '[') {
-        return R_OP_BRACKETS2;
-      } else {
-        goto none;
-      }
-    default:
-      goto none;
-    }
+  const struct op_entry* p_entry = ops_table_find(head);
+  if (!p_entry) {
+    return which_special_operator(head);
+  }
 
-  case '{':
-    if (len == 1) {
-      return R_OP_BRACES;
-    } else {
-      goto none;
-    }
+  if (p_entry->unary_op != R_OP_NONE && r_node_cddr(call) == r_null) {
+    return p_entry->unary_op;
+  } else {
+    return p_entry->op;
+  }
+}
 
-  none:
-  default:
-    return R_OP_NONE;
+// Returns a shared character vector
+sexp* r_op_as_string(enum r_operator op) {
+  if (op >= R_OP_MAX) {
+    r_abort("Internal error: `enum r_operator` out of bounds");
   }
+  return r_list_get(ops_strings, op);
 }
 
 const char* r_op_as_c_string(enum r_operator op) {
@@ -458,4 +269,55 @@ void init_parse(sexp* ns) {
       Rf_error("Internal error: `r_ops_precedence` is not fully initialised");
     }
   }
+
+  ops_table_add("break",    R_OP_BREAK,          R_OP_NONE);
+  ops_table_add("next",     R_OP_NEXT,           R_OP_NONE);
+  ops_table_add("function", R_OP_FUNCTION,       R_OP_NONE);
+  ops_table_add("while",    R_OP_WHILE,          R_OP_NONE);
+  ops_table_add("for",      R_OP_FOR,            R_OP_NONE);
+  ops_table_add("repeat",   R_OP_REPEAT,         R_OP_NONE);
+  ops_table_add("if",       R_OP_IF,             R_OP_NONE);
+  ops_table_add("?",        R_OP_QUESTION,       R_OP_QUESTION_UNARY);
+  ops_table_add("<-",       R_OP_ASSIGN1,        R_OP_NONE);
+  ops_table_add("<<-",      R_OP_ASSIGN2,        R_OP_NONE);
+  ops_table_add("=",        R_OP_ASSIGN_EQUAL,   R_OP_NONE);
+  ops_table_add(":=",       R_OP_COLON_EQUAL,    R_OP_NONE);
+  ops_table_add("~",        R_OP_TILDE,          R_OP_TILDE_UNARY);
+  ops_table_add("|",        R_OP_OR1,            R_OP_NONE);
+  ops_table_add("||",       R_OP_OR2,            R_OP_NONE);
+  ops_table_add("&",        R_OP_AND1,           R_OP_NONE);
+  ops_table_add("&&",       R_OP_AND2,           R_OP_NONE);
+  ops_table_add("!",        R_OP_BANG1,          R_OP_NONE);
+  ops_table_add("!!!",      R_OP_BANG3,          R_OP_NONE);
+  ops_table_add(">",        R_OP_GREATER,        R_OP_NONE);
+  ops_table_add(">=",       R_OP_GREATER_EQUAL,  R_OP_NONE);
+  ops_table_add("<",        R_OP_LESS,           R_OP_NONE);
+  ops_table_add("<=",       R_OP_LESS_EQUAL,     R_OP_NONE);
+  ops_table_add("==",       R_OP_EQUAL,          R_OP_NONE);
+  ops_table_add("!=",       R_OP_NOT_EQUAL,      R_OP_NONE);
+  ops_table_add("+",        R_OP_PLUS,           R_OP_PLUS_UNARY);
+  ops_table_add("-",        R_OP_MINUS,          R_OP_MINUS_UNARY);
+  ops_table_add("*",        R_OP_TIMES,          R_OP_NONE);
+  ops_table_add("/",        R_OP_RATIO,          R_OP_NONE);
+  ops_table_add("%%",       R_OP_MODULO,         R_OP_NONE);
+  ops_table_add(":",        R_OP_COLON1,         R_OP_NONE);
+  ops_table_add("!!",       R_OP_BANG2,          R_OP_NONE);
+  ops_table_add("^",        R_OP_HAT,            R_OP_NONE);
+  ops_table_add("$",        R_OP_DOLLAR,         R_OP_NONE);
+  ops_table_add("@",        R_OP_AT,             R_OP_NONE);
+  ops_table_add("::",       R_OP_COLON2,         R_OP_NONE);
+  ops_table_add(":::",      R_OP_COLON3,         R_OP_NONE);
+  ops_table_add("(",        R_OP_PARENTHESES,    R_OP_NONE);
+  ops_table_add("[",        R_OP_BRACKETS1,      R_OP_NONE);
+  ops_table_add("[[",       R_OP_BRACKETS2,      R_OP_NONE);
+  ops_table_add("{",        R_OP_BRACES,         R_OP_NONE);
+
+  ops_strings = r_new_list(R_OP_MAX);
+  r_preserve(ops_strings);
+
+  for (int i = R_OP_NONE; i < R_OP_MAX; ++i) {
+    sexp* str = r_chr(r_op_as_c_string(i));
+    r_mark_shared(str);
+    r_list_poke(ops_strings, i, str);
+  }
 }
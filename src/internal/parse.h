@@ -57,6 +57,9 @@ enum r_operator {
 
 enum r_operator r_which_operator(sexp* call);
 const char* r_op_as_c_string(enum r_operator op);
+sexp* r_op_as_string(enum r_operator op);
+
+void init_parse(sexp* ns);
 
 
 /**
@@ -1,15 +1,19 @@
 #include <rlang.h>
+#include <stdint.h>
+#include "altrep.h"
 #include "vec.h"
 
-static sexp* replace_na_(sexp* x, sexp* replacement, int start);
-static sexp* replace_na_vec_(sexp* x, sexp* replacement, int start);
+static r_ssize find_first_na(sexp* x, r_ssize n);
+static r_ssize find_first_na_deref(sexp* x, r_ssize n);
+static sexp* replace_na_(sexp* x, sexp* replacement, r_ssize start);
+static sexp* replace_na_vec_(sexp* x, sexp* replacement, r_ssize start);
 
 sexp* rlang_replace_na(sexp* x, sexp* replacement) {
   const enum r_type x_type = r_typeof(x);
   const enum r_type replacement_type = r_typeof(replacement);
 
-  int n = r_length(x);
-  int n_replacement = r_length(replacement);
+  r_ssize n = r_length(x);
+  r_ssize n_replacement = r_length(replacement);
 
   if (!r_is_atomic(x, -1)) {
     r_abort("Cannot replace missing values in an object of type %s", Rf_type2char(x_type));
@@ -21,91 +25,175 @@ sexp* rlang_replace_na(sexp* x, sexp* replacement) {
 
   if (n_replacement != 1 && n_replacement != n) {
     if (n == 1) {
-      r_abort("The replacement values must have size 1, not %i", n_replacement);
+      r_abort("The replacement values must have size 1, not %i", (int) n_replacement);
     } else {
-      r_abort("The replacement values must have size 1 or %i, not %i", n, n_replacement);
+      r_abort("The replacement values must have size 1 or %i, not %i", (int) n, (int) n_replacement);
     }
   }
 
-  int i = 0;
+  r_ssize i = find_first_na(x, n);
+  if (i == n) {
+    return x;
+  }
 
-  switch(x_type) {
-  case r_type_logical: {
-    int* arr = r_lgl_deref(x);
-    for (; i < n; ++i) {
-      if (arr[i] == r_lgls_na) {
-        break;
-      }
-    }
-    break;
+  // Callers can't tell us reliably whether `x` is referenced
+  // elsewhere: `NAMED()` may be 0 for vectors stored in attributes
+  x = KEEP(r_copy(x));
+
+  if (n_replacement == 1) {
+    replace_na_(x, replacement, i);
+  } else {
+    replace_na_vec_(x, replacement, i);
   }
 
-  case r_type_integer: {
-    int* arr = r_int_deref(x);
-    for (; i < n; ++i) {
-      if (arr[i] == r_ints_na) {
-        break;
-      }
+  FREE(1);
+  return x;
+}
+
+
+// R distinguishes the `NA` payload from other NaN values
+static inline
+bool dbl_is_na(double x) {
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(double));
+  return isnan(x) && (uint32_t) bits == 1954;
+}
+
+static
+r_ssize int_find_na(const int* v_x, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    if (v_x[i] == r_ints_na) {
+      return i;
     }
-    break;
   }
-
-  case r_type_double: {
-    double* arr = r_dbl_deref(x);
-    for (; i < n; ++i) {
-      if (ISNA(arr[i])) {
-        break;
-      }
+  return n;
+}
+static
+r_ssize dbl_find_na(const double* v_x, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    if (dbl_is_na(v_x[i])) {
+      return i;
     }
+  }
+  return n;
+}
+
+#if RLANG_HAS_ALTREP
+
+/**
+ * ALTREP vectors are scanned in chunks with `GET_REGION()` so that
+ * compact sequences or memory-mapped vectors are not materialised
+ * just to find out they don't contain missing values.
+ */
+#define NA_SCAN_CHUNK 512
+
+#define FIND_NA_REGION(CTYPE, GET_REGION, FIND)                 \
+  do {                                                          \
+    const CTYPE* v_x = (const CTYPE*) DATAPTR_OR_NULL(x);       \
+    if (v_x) {                                                  \
+      return FIND(v_x, n);                                      \
+    }                                                           \
+                                                                \
+    CTYPE buf[NA_SCAN_CHUNK];                                   \
+    for (r_ssize i = 0; i < n; i += NA_SCAN_CHUNK) {            \
+      r_ssize n_buf = GET_REGION(x, i, NA_SCAN_CHUNK, buf);     \
+      r_ssize j = FIND(buf, n_buf);                             \
+      if (j < n_buf) {                                          \
+        return i + j;                                           \
+      }                                                         \
+    }                                                           \
+    return n;                                                   \
+  } while (0)
+
+static
+r_ssize find_first_na(sexp* x, r_ssize n) {
+  switch (r_typeof(x)) {
+  case r_type_logical:
+    if (LOGICAL_NO_NA(x)) return n;
+    FIND_NA_REGION(int, LOGICAL_GET_REGION, int_find_na);
+
+  case r_type_integer:
+    if (INTEGER_NO_NA(x)) return n;
+    FIND_NA_REGION(int, INTEGER_GET_REGION, int_find_na);
+
+  case r_type_double:
+    if (REAL_NO_NA(x)) return n;
+    FIND_NA_REGION(double, REAL_GET_REGION, dbl_find_na);
+
+  case r_type_character:
+    if (STRING_NO_NA(x)) return n;
+    break;
+
+  default:
     break;
   }
 
+  return find_first_na_deref(x, n);
+}
+
+#undef FIND_NA_REGION
+#undef NA_SCAN_CHUNK
+
+#else
+
+static
+r_ssize find_first_na(sexp* x, r_ssize n) {
+  return find_first_na_deref(x, n);
+}
+
+#endif
+
+static
+r_ssize find_first_na_deref(sexp* x, r_ssize n) {
+  switch (r_typeof(x)) {
+  case r_type_logical:
+    return int_find_na(r_lgl_deref_const(x), n);
+
+  case r_type_integer:
+    return int_find_na(r_int_deref_const(x), n);
+
+  case r_type_double:
+    return dbl_find_na(r_dbl_deref_const(x), n);
+
   case r_type_character: {
-    for (; i < n; ++i) {
-      if (r_chr_get(x, i) == r_strs_na) {
-        break;
+    sexp* const * v_x = r_chr_deref_const(x);
+    for (r_ssize i = 0; i < n; ++i) {
+      if (v_x[i] == r_strs_na) {
+        return i;
       }
     }
-    break;
+    return n;
   }
 
   case r_type_complex: {
-    r_complex_t* arr = r_cpl_deref(x);
-
-    for (; i < n; ++i) {
-      if (ISNA(arr[i].r)) {
-        break;
+    const r_complex_t* v_x = r_cpl_deref_const(x);
+    for (r_ssize i = 0; i < n; ++i) {
+      if (dbl_is_na(v_x[i].r)) {
+        return i;
       }
     }
-    break;
+    return n;
   }
 
   default: {
-    r_abort("Internal error: Don't know how to handle object of type %s", Rf_type2char(x_type));
+    r_abort("Internal error: Don't know how to handle object of type %s", Rf_type2char(r_typeof(x)));
   }
   }
-
-  if (i == n) {
-    return x;
-  } else if (n_replacement == 1) {
-    return replace_na_(x, replacement, i);
-  } else {
-    return replace_na_vec_(x, replacement, i);
-  }
 }
 
-static sexp* replace_na_(sexp* x, sexp* replacement, int i) {
-  KEEP(x = r_copy(x));
-  int n = r_length(x);
+
+// The replacement loops select without branching so that the
+// compiler can vectorise them
+
+static sexp* replace_na_(sexp* x, sexp* replacement, r_ssize i) {
+  r_ssize n = r_length(x);
 
   switch(r_typeof(x)) {
   case r_type_logical: {
     int* arr = r_lgl_deref(x);
     int new_value = r_lgl_deref(replacement)[0];
     for (; i < n; ++i) {
-      if (arr[i] == r_lgls_na) {
-        arr[i] = new_value;
-      }
+      arr[i] = (arr[i] == r_lgls_na) ? new_value : arr[i];
     }
     break;
   }
@@ -114,9 +202,7 @@ static sexp* replace_na_(sexp* x, sexp* replacement, int i) {
     int* arr = r_int_deref(x);
     int new_value = r_int_deref(replacement)[0];
     for (; i < n; ++i) {
-      if (arr[i] == r_ints_na) {
-        arr[i] = new_value;
-      }
+      arr[i] = (arr[i] == r_ints_na) ? new_value : arr[i];
     }
     break;
   }
@@ -125,9 +211,7 @@ static sexp* replace_na_(sexp* x, sexp* replacement, int i) {
     double* arr = r_dbl_deref(x);
     double new_value = r_dbl_deref(replacement)[0];
     for (; i < n; ++i) {
-      if (ISNA(arr[i])) {
-        arr[i] = new_value;
-      }
+      arr[i] = dbl_is_na(arr[i]) ? new_value : arr[i];
     }
     break;
   }
@@ -147,7 +231,7 @@ static sexp* replace_na_(sexp* x, sexp* replacement, int i) {
     r_complex_t new_value = r_cpl_get(replacement, 0);
 
     for (; i < n; ++i) {
-      if (ISNA(arr[i].r)) {
+      if (dbl_is_na(arr[i].r)) {
         arr[i] = new_value;
       }
     }
@@ -159,42 +243,37 @@ static sexp* replace_na_(sexp* x, sexp* replacement, int i) {
   }
   }
 
-  FREE(1);
   return x;
 }
 
 
-static sexp* replace_na_vec_(sexp* x, sexp* replacement, int i) {
-  KEEP(x = r_copy(x));
-  int n = r_length(x);
+static sexp* replace_na_vec_(sexp* x, sexp* replacement, r_ssize i) {
+  r_ssize n = r_length(x);
 
   switch(r_typeof(x)) {
   case r_type_logical: {
     int* arr = r_lgl_deref(x);
+    const int* v_replacement = r_lgl_deref_const(replacement);
     for (; i < n; ++i) {
-      if (arr[i] == r_lgls_na) {
-        arr[i] = r_lgl_get(replacement, i);
-      }
+      arr[i] = (arr[i] == r_lgls_na) ? v_replacement[i] : arr[i];
     }
     break;
   }
 
   case r_type_integer: {
     int* arr = r_int_deref(x);
+    const int* v_replacement = r_int_deref_const(replacement);
     for (; i < n; ++i) {
-      if (arr[i] == r_ints_na) {
-        arr[i] = r_int_get(replacement, i);
-      }
+      arr[i] = (arr[i] == r_ints_na) ? v_replacement[i] : arr[i];
     }
     break;
   }
 
   case r_type_double: {
     double* arr = r_dbl_deref(x);
+    const double* v_replacement = r_dbl_deref_const(replacement);
     for (; i < n; ++i) {
-      if (ISNA(arr[i])) {
-        arr[i] = r_dbl_get(replacement, i);
-      }
+      arr[i] = dbl_is_na(arr[i]) ? v_replacement[i] : arr[i];
     }
     break;
   }
@@ -211,7 +290,7 @@ static sexp* replace_na_vec_(sexp* x, sexp* replacement, int i) {
   case r_type_complex: {
     r_complex_t* arr = r_cpl_deref(x);
     for (; i < n; ++i) {
-      if (ISNA(arr[i].r)) {
+      if (dbl_is_na(arr[i].r)) {
         arr[i] = r_cpl_get(replacement, i);
       }
     }
@@ -223,6 +302,5 @@ static sexp* replace_na_vec_(sexp* x, sexp* replacement, int i) {
   }
   }
 
-  FREE(1);
   return x;
 }
@@ -9,9 +9,10 @@ void r_vec_poke_n(sexp* x, r_ssize offset,
                   sexp* y, r_ssize from, r_ssize n);
 
 
-// The vector to splice might be boxed in a sentinel wrapper
-static sexp* maybe_unbox(sexp* x, bool (*is_spliceable)(sexp*)) {
-  if (is_spliceable(x) && is_splice_box(x)) {
+// The vector to splice might be boxed in a sentinel wrapper. Only
+// called on inputs that satisfy the predicate.
+static sexp* maybe_unbox(sexp* x) {
+  if (is_splice_box(x)) {
     return r_vec_coerce(rlang_unbox(x), r_type_list);
   } else {
     return x;
@@ -26,11 +27,80 @@ bool has_name_at(sexp* x, r_ssize i) {
 }
 
 
+// Predicates ---------------------------------------------------------
+
+/**
+ * Spliceability predicate. C predicates are called directly. R
+ * predicates are only evaluated in the first pass and their results
+ * are recorded in the order of evaluation. The second pass visits the
+ * inputs in the same order and replays these results.
+ *
+ * Vectorised R predicates are called once on each list to splice and
+ * return a logical vector with one flag per element.
+ */
+struct squash_pred {
+  bool (*fn)(sexp*);
+
+  sexp* call;
+  bool vectorised;
+
+  struct r_dyn_array* p_flags;
+  r_ssize i_flag;
+  bool replay;
+};
+
+static
+bool pred_eval(struct squash_pred* p_pred, sexp* x) {
+  r_node_poke_cadr(p_pred->call, x);
+  sexp* out = r_eval(p_pred->call, R_GlobalEnv);
+  return r_lgl_get(out, 0);
+}
+
+// Returns the flags of all elements of `outer` for vectorised
+// predicates, `r_null` otherwise
+static
+sexp* pred_eval_outer(struct squash_pred* p_pred, sexp* outer) {
+  if (!p_pred->vectorised || p_pred->replay) {
+    return r_null;
+  }
+
+  r_node_poke_cadr(p_pred->call, outer);
+  sexp* out = r_eval(p_pred->call, R_GlobalEnv);
+
+  if (r_typeof(out) != r_type_logical || r_length(out) != r_length(outer)) {
+    r_abort("Vectorised predicate must return a logical vector as long as its input.");
+  }
+
+  return out;
+}
+
+static
+bool pred_is_spliceable(struct squash_pred* p_pred, sexp* x, sexp* flags, r_ssize i) {
+  if (p_pred->fn) {
+    return p_pred->fn(x);
+  }
+
+  if (p_pred->replay) {
+    const int* v_flags = (const int*) r_arr_ptr_const_front(p_pred->p_flags);
+    return v_flags[p_pred->i_flag++];
+  }
+
+  int out = (flags == r_null) ? pred_eval(p_pred, x) : r_lgl_get(flags, i);
+  r_int_push_back(p_pred->p_flags, out);
+  return out;
+}
+
+
 typedef struct {
   r_ssize size;
   bool named;
   bool warned;
   bool recursive;
+
+  // Sizes of the atomic inputs, recorded in the first pass in the
+  // order in which the second pass visits them
+  struct r_dyn_array* p_sizes;
+  r_ssize i_size;
 } squash_info_t;
 
 static squash_info_t squash_info_init(bool recursive) {
@@ -39,15 +109,17 @@ static squash_info_t squash_info_init(bool recursive) {
   info.named = false;
   info.warned = false;
   info.recursive = recursive;
+  info.p_sizes = NULL;
+  info.i_size = 0;
   return info;
 }
 
 
 // Atomic squashing ---------------------------------------------------
 
-static r_ssize atom_squash(enum r_type kind, squash_info_t info,
+static r_ssize atom_squash(enum r_type kind, squash_info_t* info,
                             sexp* outer, sexp* out, r_ssize count,
-                            bool (*is_spliceable)(sexp*), int depth) {
+                            struct squash_pred* p_pred, int depth) {
   if (r_typeof(outer) != VECSXP) {
     r_abort("Only lists can be spliced");
   }
@@ -57,18 +129,27 @@ static r_ssize atom_squash(enum r_type kind, squash_info_t info,
   r_ssize n_outer = r_length(outer);
   r_ssize n_inner;
 
+  const r_ssize* v_sizes = (const r_ssize*) r_arr_ptr_const_front(info->p_sizes);
+
+  sexp* flags = depth != 0 ? pred_eval_outer(p_pred, outer) : r_null;
+  KEEP(flags);
+
   for (r_ssize i = 0; i != n_outer; ++i) {
     inner = r_list_get(outer, i);
-    n_inner = r_vec_length(maybe_unbox(inner, is_spliceable));
 
-    if (depth != 0 && is_spliceable(inner)) {
-      inner = PROTECT(maybe_unbox(inner, is_spliceable));
-      count = atom_squash(kind, info, inner, out, count, is_spliceable, depth - 1);
+    if (depth != 0 && pred_is_spliceable(p_pred, inner, flags, i)) {
+      inner = PROTECT(maybe_unbox(inner));
+      count = atom_squash(kind, info, inner, out, count, p_pred, depth - 1);
       UNPROTECT(1);
-    } else if (n_inner) {
+      continue;
+    }
+
+    n_inner = v_sizes[info->i_size++];
+
+    if (n_inner) {
       r_vec_poke_coerce_n(out, count, inner, 0, n_inner);
 
-      if (info.named) {
+      if (info->named) {
         sexp* nms = r_names(inner);
         if (r_typeof(nms) == r_type_character) {
           r_vec_poke_n(out_names, count, nms, 0, n_inner);
@@ -81,7 +162,7 @@ static r_ssize atom_squash(enum r_type kind, squash_info_t info,
     }
   }
 
-  FREE(1);
+  FREE(2);
   return count;
 }
 
@@ -90,7 +171,7 @@ static r_ssize atom_squash(enum r_type kind, squash_info_t info,
 
 static r_ssize list_squash(squash_info_t info, sexp* outer,
                             sexp* out, r_ssize count,
-                            bool (*is_spliceable)(sexp*), int depth) {
+                            struct squash_pred* p_pred, int depth) {
   if (r_typeof(outer) != VECSXP) {
     r_abort("Only lists can be spliced");
   }
@@ -99,12 +180,15 @@ static r_ssize list_squash(squash_info_t info, sexp* outer,
   sexp* out_names = KEEP(r_names(out));
   r_ssize n_outer = r_length(outer);
 
+  sexp* flags = depth != 0 ? pred_eval_outer(p_pred, outer) : r_null;
+  KEEP(flags);
+
   for (r_ssize i = 0; i != n_outer; ++i) {
     inner = r_list_get(outer, i);
 
-    if (depth != 0 && is_spliceable(inner)) {
-      inner = PROTECT(maybe_unbox(inner, is_spliceable));
-      count = list_squash(info, inner, out, count, is_spliceable, depth - 1);
+    if (depth != 0 && pred_is_spliceable(p_pred, inner, flags, i)) {
+      inner = PROTECT(maybe_unbox(inner));
+      count = list_squash(info, inner, out, count, p_pred, depth - 1);
       UNPROTECT(1);
     } else {
       r_list_poke(out, count, inner);
@@ -118,7 +202,7 @@ static r_ssize list_squash(squash_info_t info, sexp* outer,
     }
   }
 
-  FREE(1);
+  FREE(2);
   return count;
 }
 
@@ -135,8 +219,8 @@ static void update_info_outer(squash_info_t* info, sexp* outer, r_ssize i) {
     info->warned = true;
   }
 }
-static void update_info_inner(squash_info_t* info, sexp* outer, r_ssize i, sexp* inner) {
-  r_ssize n_inner = info->recursive ? 1 : r_vec_length(inner);
+static void update_info_inner(squash_info_t* info, sexp* outer, r_ssize i,
+                              sexp* inner, r_ssize n_inner) {
   info->size += n_inner;
 
   // Return early if possible
@@ -166,7 +250,7 @@ static void update_info_inner(squash_info_t* info, sexp* outer, r_ssize i, sexp*
 }
 
 static void squash_info(squash_info_t* info, sexp* outer,
-                        bool (*is_spliceable)(sexp*), int depth) {
+                        struct squash_pred* p_pred, int depth) {
   if (r_typeof(outer) != r_type_list) {
     r_abort("Only lists can be spliced");
   }
@@ -174,27 +258,53 @@ static void squash_info(squash_info_t* info, sexp* outer,
   sexp* inner;
   r_ssize n_outer = r_length(outer);
 
+  sexp* flags = depth != 0 ? pred_eval_outer(p_pred, outer) : r_null;
+  KEEP(flags);
+
   for (r_ssize i = 0; i != n_outer; ++i) {
     inner = r_list_get(outer, i);
 
-    if (depth != 0 && is_spliceable(inner)) {
+    if (depth != 0 && pred_is_spliceable(p_pred, inner, flags, i)) {
       update_info_outer(info, outer, i);
-      inner = PROTECT(maybe_unbox(inner, is_spliceable));
-      squash_info(info, inner, is_spliceable, depth - 1);
+      inner = PROTECT(maybe_unbox(inner));
+      squash_info(info, inner, p_pred, depth - 1);
       UNPROTECT(1);
-    } else if (info->recursive || r_vec_length(inner)) {
-      update_info_inner(info, outer, i, inner);
+    } else if (info->recursive) {
+      update_info_inner(info, outer, i, inner, 1);
+    } else {
+      r_ssize n_inner = r_vec_length(inner);
+      r_arr_push_back(info->p_sizes, &n_inner);
+
+      if (n_inner) {
+        update_info_inner(info, outer, i, inner, n_inner);
+      }
     }
   }
+
+  FREE(1);
 }
 
-static sexp* squash(enum r_type kind, sexp* dots, bool (*is_spliceable)(sexp*), int depth) {
+static sexp* squash(enum r_type kind, sexp* dots, struct squash_pred* p_pred, int depth) {
   bool recursive = kind == VECSXP;
 
   squash_info_t info = squash_info_init(recursive);
-  squash_info(&info, dots, is_spliceable, depth);
 
-  sexp* out = KEEP(r_new_vector(kind, info.size));
+  int n_protect = 0;
+  if (!recursive) {
+    info.p_sizes = r_new_dyn_array(sizeof(r_ssize), r_length(dots) + 1);
+    KEEP_N(info.p_sizes->shelter, &n_protect);
+  }
+  if (!p_pred->fn) {
+    p_pred->p_flags = r_new_dyn_vector(r_type_integer, r_length(dots) + 1);
+    KEEP_N(p_pred->p_flags->shelter, &n_protect);
+  }
+
+  squash_info(&info, dots, p_pred, depth);
+
+  p_pred->replay = true;
+  p_pred->i_flag = 0;
+
+  sexp* out = KEEP_N(r_new_vector(kind, info.size), &n_protect);
   if (info.named) {
     sexp* nms = KEEP(r_new_vector(r_type_character, info.size));
     r_attrib_poke_names(out, nms);
@@ -202,12 +312,12 @@ static sexp* squash(enum r_type kind, sexp* dots, bool (*is_spliceable)(sexp*),
   }
 
   if (recursive) {
-    list_squash(info, dots, out, 0, is_spliceable, depth);
+    list_squash(info, dots, out, 0, p_pred, depth);
   } else {
-    atom_squash(kind, info, dots, out, 0, is_spliceable, depth);
+    atom_squash(kind, &info, dots, out, 0, p_pred, depth);
   }
 
-  FREE(1);
+  FREE(n_protect);
   return out;
 }
 
@@ -266,23 +376,17 @@ static is_spliceable_t predicate_internal(sexp* x) {
   return NULL;
 }
 
-// Emulate closure behaviour with global variable.
-static sexp* clo_spliceable = NULL;
-
-static bool is_spliceable_closure(sexp* x) {
-  if (!clo_spliceable) {
-    r_abort("Internal error while splicing");
-  }
-  SETCADR(clo_spliceable, x);
-
-  sexp* out = r_eval(clo_spliceable, R_GlobalEnv);
-  return r_lgl_get(out, 0);
+static bool is_vectorised_predicate(sexp* x) {
+  return
+    r_typeof(x) == r_type_list &&
+    r_length(x) == 1 &&
+    Rf_inherits(x, "rlang_vectorised_predicate");
 }
 
 
 // Export ------------------------------------------------------------
 
-sexp* r_squash_if(sexp* dots, enum r_type kind, bool (*is_spliceable)(sexp*), int depth) {
+static sexp* squash_if(sexp* dots, enum r_type kind, struct squash_pred* p_pred, int depth) {
   switch (kind) {
   case r_type_logical:
   case r_type_integer:
@@ -291,21 +395,41 @@ sexp* r_squash_if(sexp* dots, enum r_type kind, bool (*is_spliceable)(sexp*), in
   case r_type_character:
   case RAWSXP:
   case VECSXP:
-    return squash(kind, dots, is_spliceable, depth);
+    return squash(kind, dots, p_pred, depth);
   default:
     r_abort("Splicing is not implemented for this type");
     return r_null;
   }
 }
+sexp* r_squash_if(sexp* dots, enum r_type kind, bool (*is_spliceable)(sexp*), int depth) {
+  struct squash_pred pred = {
+    .fn = is_spliceable,
+    .call = r_null,
+    .vectorised = false,
+    .p_flags = NULL,
+    .i_flag = 0,
+    .replay = false
+  };
+  return squash_if(dots, kind, &pred, depth);
+}
 sexp* rlang_squash_closure(sexp* dots, enum r_type kind, sexp* pred, int depth) {
-  sexp* prev_pred = clo_spliceable;
-  clo_spliceable = KEEP(Rf_lang2(pred, Rf_list2(r_null, r_null)));
+  bool vectorised = is_vectorised_predicate(pred);
+  if (vectorised) {
+    pred = r_list_get(pred, 0);
+  }
 
-  sexp* out = r_squash_if(dots, kind, &is_spliceable_closure, depth);
+  struct squash_pred squash_pred = {
+    .fn = NULL,
+    .call = KEEP(Rf_lang2(pred, r_null)),
+    .vectorised = vectorised,
+    .p_flags = NULL,
+    .i_flag = 0,
+    .replay = false
+  };
 
-  clo_spliceable = prev_pred;
-  FREE(1);
+  sexp* out = squash_if(dots, kind, &squash_pred, depth);
 
+  FREE(1);
   return out;
 }
 sexp* rlang_squash(sexp* dots, sexp* type, sexp* pred, sexp* depth_) {
@@ -324,6 +448,9 @@ sexp* rlang_squash(sexp* dots, sexp* type, sexp* pred, sexp* depth_) {
   case r_type_special:
     return rlang_squash_closure(dots, kind, pred, depth);
   default:
+    if (is_vectorised_predicate(pred)) {
+      return rlang_squash_closure(dots, kind, pred, depth);
+    }
     is_spliceable = predicate_pointer(pred);
     return r_squash_if(dots, kind, is_spliceable, depth);
   }
@@ -0,0 +1,608 @@
+#include <rlang.h>
+
+#ifndef _WIN32
+# include <time.h>
+# include <R_ext/eventloop.h>
+# define RLANG_HAS_TRACE_SAMPLE 1
+#else
+# define RLANG_HAS_TRACE_SAMPLE 0
+#endif
+
+static sexp* sys_calls_call = NULL;
+static sexp* sys_parents_call = NULL;
+static sexp* sys_frames_call = NULL;
+static sexp* sys_function_call = NULL;
+static int* sys_function_n_addr = NULL;
+static sexp* pipe_sym = NULL;
+static sexp* package_name_sym = NULL;
+
+static sexp* fn_top_env(sexp* fn);
+static sexp* frames_subset(sexp* frames, r_ssize start, r_ssize end);
+static void trace_compress(sexp* data);
+
+
+/**
+ * Captures the data of a backtrace in a single pass over the call
+ * stack of `frame`. Only pointers are recorded:
+ *
+ * - The calls of the first `n` frames.
+ * - Their parents, normalised so that recursive frames (which occur
+ *   with quosures) point to the root.
+ * - The top environment of each frame function. This is the global
+ *   environment, a namespace, or `NULL`. It is used to namespace the
+ *   calls lazily, when the backtrace is first displayed.
+ * - The frame environments, but only when the backtrace contains
+ *   magrittr pipes. These need to be inspected eagerly because the
+ *   pipe pointers change as the pipe progresses.
+ *
+ * Frames up to and including the last occurrence of `top` are
+ * trimmed off. Repeated frames are then compressed if `compress` is
+ * `TRUE`, see `trace_compress()`.
+ */
+sexp* rlang_trace_capture(sexp* n, sexp* top, sexp* compress, sexp* frame) {
+  r_ssize n_frames = r_as_ssize(n);
+
+  sexp* calls = KEEP(r_eval(sys_calls_call, frame));
+  sexp* parents = KEEP(r_eval(sys_parents_call, frame));
+
+  n_frames = r_ssize_min(n_frames, r_length(parents));
+  const int* v_parents = r_int_deref_const(parents);
+
+  sexp* frames = r_null;
+  if (top != r_null) {
+    frames = r_eval(sys_frames_call, frame);
+  }
+  KEEP(frames);
+
+  r_ssize start = 0;
+  if (top != r_null) {
+    sexp* node = frames;
+    for (r_ssize i = 0; i < n_frames; ++i, node = r_node_cdr(node)) {
+      if (r_node_car(node) == top) {
+        start = i + 1;
+      }
+    }
+  }
+
+  r_ssize size = n_frames - start;
+
+  sexp* out = KEEP(r_new_list(5));
+
+  sexp* out_calls = r_new_list(size);
+  r_list_poke(out, 0, out_calls);
+
+  sexp* out_parents = r_new_integer(size);
+  r_list_poke(out, 1, out_parents);
+  int* v_out_parents = r_int_deref(out_parents);
+
+  sexp* out_tops = r_new_list(size);
+  r_list_poke(out, 2, out_tops);
+
+  bool has_pipe = false;
+
+  sexp* node = calls;
+  for (r_ssize i = 0; i < n_frames; ++i, node = r_node_cdr(node)) {
+    if (i < start) {
+      continue;
+    }
+    r_ssize j = i - start;
+
+    sexp* call = r_node_car(node);
+
+    // Work around R bug causing promises to leak in frame calls
+    sexp* car = r_node_car(call);
+    if (r_typeof(car) == r_type_promise) {
+      r_node_poke_car(call, r_eval(car, r_base_env));
+    }
+
+    has_pipe = has_pipe || r_node_car(call) == pipe_sym;
+    r_list_poke(out_calls, j, call);
+
+    // Remove recursive frames which occur with quosures
+    int parent = v_parents[i];
+    if (parent == i + 1) {
+      parent = 0;
+    }
+    v_out_parents[j] = (parent > start) ? parent - start : 0;
+
+    *sys_function_n_addr = i + 1;
+    sexp* fn = KEEP(r_eval(sys_function_call, frame));
+    r_list_poke(out_tops, j, fn_top_env(fn));
+    FREE(1);
+  }
+
+  if (has_pipe) {
+    if (frames == r_null) {
+      frames = r_eval(sys_frames_call, frame);
+    }
+    KEEP(frames);
+    r_list_poke(out, 3, frames_subset(frames, start, n_frames));
+    FREE(1);
+  } else if (r_as_bool(compress)) {
+    // The pipe pointers are found by position so these traces are
+    // not compressed
+    trace_compress(out);
+  }
+
+  FREE(4);
+  return out;
+}
+
+/**
+ * Runaway recursions produce call stacks of thousands of frames that
+ * repeat the same few calls. Runs of frames that repeat the previous
+ * `period` frames, with the same relative parents, are compressed
+ * when they are long enough. The first and last `TRACE_REPEAT_KEEP`
+ * frames of the run are kept (rounded up to a whole period) and the
+ * frames in the middle are replaced by a single marker node. The
+ * marker has a `NULL` call and records the number of frames it
+ * stands for in the `repeats` vector (the fifth element of `data`).
+ * Children of elided frames are reattached to the marker.
+ *
+ * Calls are compared by pointer. Frame calls point to the code being
+ * evaluated so recursive calls from the same call site are identical.
+ */
+
+#define TRACE_REPEAT_KEEP 10
+#define TRACE_REPEAT_MIN_ELIDED 20
+#define TRACE_REPEAT_MAX_PERIOD 8
+
+static inline
+bool trace_frame_repeats(sexp* const * v_calls,
+                         const int* v_parents,
+                         r_ssize i,
+                         r_ssize period) {
+  int parent = v_parents[i];
+  int prev_parent = v_parents[i - period];
+
+  return
+    v_calls[i] == v_calls[i - period] &&
+    parent && prev_parent &&
+    parent - i == prev_parent - (i - period);
+}
+
+static
+void trace_compress(sexp* data) {
+  sexp* calls = r_list_get(data, 0);
+  sexp* parents = r_list_get(data, 1);
+  sexp* tops = r_list_get(data, 2);
+
+  r_ssize size = r_length(calls);
+  if (size < 2 * TRACE_REPEAT_KEEP + TRACE_REPEAT_MIN_ELIDED) {
+    return;
+  }
+
+  sexp* const * v_calls = r_list_deref_const(calls);
+  const int* v_parents = r_int_deref_const(parents);
+
+  // Collect the elided ranges as pairs of start and size
+  struct r_dyn_array* p_elided = r_new_dyn_vector(r_type_integer, 8);
+  KEEP(p_elided->shelter);
+  r_ssize n_elided = 0;
+
+  r_ssize loc = 1;
+  while (loc < size) {
+    r_ssize run = 0;
+    r_ssize period = 0;
+
+    for (r_ssize p = 1; p <= TRACE_REPEAT_MAX_PERIOD && p <= loc; ++p) {
+      r_ssize j = loc;
+      while (j < size && trace_frame_repeats(v_calls, v_parents, j, p)) {
+        ++j;
+      }
+      if (j - loc > run) {
+        run = j - loc;
+        period = p;
+      }
+    }
+
+    if (!run) {
+      ++loc;
+      continue;
+    }
+
+    r_ssize keep = period * ((TRACE_REPEAT_KEEP + period - 1) / period);
+    r_ssize elided = run - 2 * keep;
+    elided -= elided % period;
+
+    if (elided < TRACE_REPEAT_MIN_ELIDED) {
+      ++loc;
+      continue;
+    }
+
+    r_int_push_back(p_elided, loc + keep);
+    r_int_push_back(p_elided, elided);
+    n_elided += elided;
+    loc += run;
+  }
+
+  r_ssize n_runs = p_elided->count / 2;
+  if (!n_runs) {
+    FREE(1);
+    return;
+  }
+
+  const int* v_elided = (const int*) p_elided->v_data_const;
+
+  r_ssize out_size = size - n_elided + n_runs;
+  sexp* out_calls = KEEP(r_new_list(out_size));
+  sexp* out_parents = KEEP(r_new_integer(out_size));
+  sexp* out_tops = KEEP(r_new_list(out_size));
+  sexp* out_repeats = KEEP(r_new_integer(out_size));
+
+  int* v_out_parents = r_int_deref(out_parents);
+  int* v_out_repeats = r_int_deref(out_repeats);
+
+  // Maps frame locations to 1-based node locations in the output
+  sexp* map = KEEP(r_new_integer(size));
+  int* v_map = r_int_deref(map);
+
+  r_ssize run_i = 0;
+  r_ssize k = 0;
+
+  for (r_ssize i = 0; i < size; ++i) {
+    int parent = v_parents[i];
+    parent = parent ? v_map[parent - 1] : 0;
+
+    if (run_i < n_runs && i == v_elided[2 * run_i]) {
+      r_ssize elided = v_elided[2 * run_i + 1];
+
+      v_out_parents[k] = parent;
+      v_out_repeats[k] = elided;
+      ++k;
+
+      for (r_ssize j = i; j < i + elided; ++j) {
+        v_map[j] = k;
+      }
+
+      i += elided - 1;
+      ++run_i;
+      continue;
+    }
+
+    r_list_poke(out_calls, k, v_calls[i]);
+    r_list_poke(out_tops, k, r_list_get(tops, i));
+    v_out_parents[k] = parent;
+    v_out_repeats[k] = 0;
+    ++k;
+
+    v_map[i] = k;
+  }
+
+  r_list_poke(data, 0, out_calls);
+  r_list_poke(data, 1, out_parents);
+  r_list_poke(data, 2, out_tops);
+  r_list_poke(data, 4, out_repeats);
+
+  FREE(6);
+}
+
+#undef TRACE_REPEAT_KEEP
+#undef TRACE_REPEAT_MIN_ELIDED
+#undef TRACE_REPEAT_MAX_PERIOD
+
+// Follows the semantics of `topenv()`, except that functions
+// defined in the global environment are distinguished from those
+// defined in a child of the global environment
+static
+sexp* fn_top_env(sexp* fn) {
+  if (r_typeof(fn) != r_type_closure) {
+    return r_null;
+  }
+
+  sexp* env = r_fn_env(fn);
+  if (env == r_global_env) {
+    return env;
+  }
+
+  while (env != r_empty_env) {
+    if (R_IsNamespaceEnv(env)) {
+      return env;
+    }
+    if (env == r_global_env ||
+        env == r_base_env ||
+        R_IsPackageEnv(env) ||
+        r_env_has(env, package_name_sym)) {
+      return r_null;
+    }
+    env = r_env_parent(env);
+  }
+
+  return r_null;
+}
+
+static
+sexp* frames_subset(sexp* frames, r_ssize start, r_ssize end) {
+  sexp* out = KEEP(r_new_list(end - start));
+
+  sexp* node = frames;
+  for (r_ssize i = 0; i < end; ++i, node = r_node_cdr(node)) {
+    if (i >= start) {
+      r_list_poke(out, i - start, r_node_car(node));
+    }
+  }
+
+  FREE(1);
+  return out;
+}
+
+
+/**
+ * Sampling profiler. Samples are taken from the `R_PolledEvents`
+ * hook, which R calls when it checks for user interrupts. This
+ * happens regularly during evaluation and only at points where the
+ * evaluator is in a consistent state, so that it is safe to inspect
+ * the call stack from there. The hook checks the monotonic clock and
+ * only takes a sample once `interval` seconds have passed.
+ *
+ * Each sample records the stack as a vector of call ids, followed by
+ * the normalised parents. Calls are interned by pointer: frame calls
+ * point to the code being evaluated, so a given call site is stored
+ * once for the whole session. The top environment of the frame
+ * function is recorded alongside the call when it is interned.
+ * Samples are stored in a ring buffer of `max_samples` elements.
+ */
+
+#define SAMPLE_CALLS_INIT_SIZE 256
+
+static bool sample_active = false;
+static bool sample_busy = false;
+static double sample_interval = 0;
+static double sample_deadline = 0;
+static double sample_overhead = 0;
+static r_ssize sample_skip = 0;
+static r_ssize sample_max = 0;
+static r_ssize sample_n_taken = 0;
+
+static sexp* sample_shelter = NULL;
+static struct r_dict* p_sample_ids = NULL;
+static struct r_dyn_array* p_sample_calls = NULL;
+static struct r_dyn_array* p_sample_tops = NULL;
+static sexp* sample_ring = NULL;
+
+#if RLANG_HAS_TRACE_SAMPLE
+
+static void (*sample_old_polled_events)(void) = NULL;
+
+static
+double sample_clock() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static
+int sample_intern(sexp* call, int frame_n, sexp* frame) {
+  sexp* id = r_dict_get0(p_sample_ids, call);
+  if (id) {
+    return r_int_get(id, 0);
+  }
+
+  // Ids are 1-based so they can be used as R indices
+  int new_id = p_sample_calls->count + 1;
+
+  id = KEEP(r_int(new_id));
+  r_dict_put(p_sample_ids, call, id);
+  r_arr_push_back(p_sample_calls, call);
+
+  *sys_function_n_addr = frame_n;
+  sexp* fn = KEEP(r_eval(sys_function_call, frame));
+  r_arr_push_back(p_sample_tops, fn_top_env(fn));
+
+  FREE(2);
+  return new_id;
+}
+
+static
+void sample_take() {
+  sexp* frame = KEEP(r_peek_frame());
+  sexp* calls = KEEP(r_eval(sys_calls_call, frame));
+  sexp* parents = KEEP(r_eval(sys_parents_call, frame));
+
+  r_ssize n = r_length(parents);
+  r_ssize skip = r_ssize_min(sample_skip, n);
+  r_ssize size = n - skip;
+
+  if (size == 0) {
+    FREE(3);
+    return;
+  }
+
+  const int* v_parents = r_int_deref_const(parents);
+
+  sexp* sample = KEEP(r_new_integer(2 * size));
+  int* v_sample = r_int_deref(sample);
+
+  sexp* node = calls;
+  for (r_ssize i = 0; i < n; ++i, node = r_node_cdr(node)) {
+    if (i < skip) {
+      continue;
+    }
+    r_ssize j = i - skip;
+
+    sexp* call = r_node_car(node);
+
+    sexp* car = r_node_car(call);
+    if (r_typeof(car) == r_type_promise) {
+      r_node_poke_car(call, r_eval(car, r_base_env));
+    }
+
+    int parent = v_parents[i];
+    if (parent == i + 1) {
+      parent = 0;
+    }
+
+    v_sample[j] = sample_intern(call, i + 1, frame);
+    v_sample[size + j] = (parent > skip) ? parent - skip : 0;
+  }
+
+  r_list_poke(sample_ring, sample_n_taken % sample_max, sample);
+  ++sample_n_taken;
+
+  FREE(4);
+}
+
+static
+sexp* sample_take_impl(void* data) {
+  sample_take();
+  return r_null;
+}
+static
+void sample_take_cleanup(void* data) {
+  sample_busy = false;
+}
+
+static
+void sample_poll() {
+  if (sample_old_polled_events) {
+    sample_old_polled_events();
+  }
+
+  // Evaluating the `sys.` functions checks for interrupts. The busy
+  // flag prevents reentrant sampling. It is cleared on exit, including
+  // when an interrupt jumps out of `sample_take()`.
+  if (!sample_active || sample_busy) {
+    return;
+  }
+
+  double now = sample_clock();
+  if (now < sample_deadline) {
+    return;
+  }
+
+  sample_busy = true;
+  R_ExecWithCleanup(sample_take_impl, NULL, sample_take_cleanup, NULL);
+
+  double end = sample_clock();
+  sample_overhead += end - now;
+  sample_deadline = end + sample_interval;
+}
+
+// Restores the previous hook if ours is still installed. If another
+// package has chained itself after our hook, it stays installed and
+// is a no-op while inactive.
+static
+void sample_uninstall_hook() {
+  if (R_PolledEvents == &sample_poll) {
+    R_PolledEvents = sample_old_polled_events;
+    sample_old_polled_events = NULL;
+  }
+}
+
+#endif
+
+sexp* rlang_trace_sample_start(sexp* interval, sexp* max_samples, sexp* skip) {
+#if RLANG_HAS_TRACE_SAMPLE
+  if (sample_active) {
+    r_abort("Can't sample backtraces while another sampling session is running.");
+  }
+
+  sample_interval = r_dbl_get(interval, 0);
+  sample_max = r_as_ssize(max_samples);
+  sample_skip = r_as_ssize(skip);
+  sample_n_taken = 0;
+  sample_overhead = 0;
+  sample_busy = false;
+
+  p_sample_ids = r_new_dict(SAMPLE_CALLS_INIT_SIZE);
+  r_list_poke(sample_shelter, 0, p_sample_ids->shelter);
+
+  p_sample_calls = r_new_dyn_vector(r_type_list, SAMPLE_CALLS_INIT_SIZE);
+  r_list_poke(sample_shelter, 1, p_sample_calls->shelter);
+
+  p_sample_tops = r_new_dyn_vector(r_type_list, SAMPLE_CALLS_INIT_SIZE);
+  r_list_poke(sample_shelter, 2, p_sample_tops->shelter);
+
+  sample_ring = r_new_list(sample_max);
+  r_list_poke(sample_shelter, 3, sample_ring);
+
+  // Other packages may have installed a hook. It is called first by
+  // ours. Our hook may still be installed from an earlier session if
+  // another hook was chained after it.
+  if (R_PolledEvents != &sample_poll) {
+    sample_old_polled_events = R_PolledEvents;
+    R_PolledEvents = &sample_poll;
+  }
+
+  sample_deadline = sample_clock() + sample_interval;
+  sample_active = true;
+
+  return r_null;
+#else
+  r_abort("Sampling backtraces is not supported on Windows.");
+#endif
+}
+
+sexp* rlang_trace_sample_stop() {
+  if (!sample_active) {
+    r_abort("Internal error: No backtrace sampling session is running.");
+  }
+
+  sample_active = false;
+  sample_busy = false;
+
+#if RLANG_HAS_TRACE_SAMPLE
+  sample_uninstall_hook();
+#endif
+
+  r_ssize n = r_ssize_min(sample_n_taken, sample_max);
+  r_ssize first = (sample_n_taken > sample_max) ? sample_n_taken % sample_max : 0;
+
+  sexp* out = KEEP(r_new_list(5));
+  r_list_poke(out, 0, r_arr_unwrap(p_sample_calls));
+  r_list_poke(out, 1, r_arr_unwrap(p_sample_tops));
+
+  sexp* samples = r_new_list(n);
+  r_list_poke(out, 2, samples);
+  for (r_ssize i = 0; i < n; ++i) {
+    r_list_poke(samples, i, r_list_get(sample_ring, (first + i) % sample_max));
+  }
+
+  r_list_poke(out, 3, r_dbl(sample_n_taken));
+  r_list_poke(out, 4, r_dbl(sample_overhead));
+
+  for (r_ssize i = 0; i < 4; ++i) {
+    r_list_poke(sample_shelter, i, r_null);
+  }
+  p_sample_ids = NULL;
+  p_sample_calls = NULL;
+  p_sample_tops = NULL;
+  sample_ring = NULL;
+
+  FREE(1);
+  return out;
+}
+
+
+// The hook must not point into the DLL once it is unloaded
+void rlang_unload_trace() {
+#if RLANG_HAS_TRACE_SAMPLE
+  sample_active = false;
+  sample_uninstall_hook();
+#endif
+}
+
+void rlang_init_trace() {
+  sys_calls_call = r_new_call(r_base_ns_get("sys.calls"), r_null);
+  r_preserve(sys_calls_call);
+
+  sys_parents_call = r_new_call(r_base_ns_get("sys.parents"), r_null);
+  r_preserve(sys_parents_call);
+
+  sys_frames_call = r_new_call(r_base_ns_get("sys.frames"), r_null);
+  r_preserve(sys_frames_call);
+
+  sexp* sys_function_n = KEEP(r_int(0));
+  sys_function_n_addr = r_int_deref(sys_function_n);
+
+  sexp* sys_function_args = KEEP(r_new_node(sys_function_n, r_null));
+  sys_function_call = r_new_call(r_base_ns_get("sys.function"), sys_function_args);
+  r_preserve(sys_function_call);
+  FREE(2);
+
+  pipe_sym = r_sym("%>%");
+  package_name_sym = r_sym(".packageName");
+
+  sample_shelter = r_new_list(4);
+  r_preserve(sample_shelter);
+}
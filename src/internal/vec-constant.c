@@ -0,0 +1,325 @@
+#include <rlang.h>
+#include <R_ext/Rdynload.h>
+#include "altrep.h"
+#include "vec-constant.h"
+
+/**
+ * Constant vectors are ALTREP vectors repeating a single value `n`
+ * times in constant memory. They are used for default names and
+ * for repeating scalars along other vectors. Reading an element
+ * reads the scalar. The full vector is only allocated when a pointer
+ * to the data is requested or when an element is modified.
+ *
+ * The `data1` slot contains the scalar value, or the materialised
+ * vector. The `data2` slot is a double vector containing the size
+ * and whether `data1` has been materialised.
+ */
+
+#define CONSTANT_SIZE 0
+#define CONSTANT_OWNED 1
+
+// Below this size the cost of ALTREP dispatch on every element
+// access outweighs the saved memory
+#define CONSTANT_MIN_SIZE 128
+
+static sexp* vec_rep_payload(sexp* x, r_ssize n);
+
+
+#if RLANG_HAS_ALTREP
+
+static R_altrep_class_t constant_lgl_class;
+static R_altrep_class_t constant_int_class;
+static R_altrep_class_t constant_dbl_class;
+static R_altrep_class_t constant_chr_class;
+
+static inline
+sexp* constant_data(sexp* x) {
+  return R_altrep_data1(x);
+}
+static inline
+r_ssize constant_size(sexp* x) {
+  return (r_ssize) r_dbl_get(R_altrep_data2(x), CONSTANT_SIZE);
+}
+static inline
+bool constant_is_owned(sexp* x) {
+  return r_dbl_get(R_altrep_data2(x), CONSTANT_OWNED);
+}
+
+static
+bool constant_class(enum r_type type, R_altrep_class_t* p_cls) {
+  switch (type) {
+  case r_type_logical: *p_cls = constant_lgl_class; return true;
+  case r_type_integer: *p_cls = constant_int_class; return true;
+  case r_type_double: *p_cls = constant_dbl_class; return true;
+  case r_type_character: *p_cls = constant_chr_class; return true;
+  default: return false;
+  }
+}
+
+static
+sexp* new_constant(R_altrep_class_t cls, sexp* value, r_ssize n) {
+  sexp* info = KEEP(r_new_double(2));
+  double* p_info = r_dbl_deref(info);
+  p_info[CONSTANT_SIZE] = n;
+  p_info[CONSTANT_OWNED] = 0;
+
+  sexp* out = R_new_altrep(cls, value, info);
+
+  FREE(1);
+  return out;
+}
+
+static
+void constant_materialise(sexp* x) {
+  if (constant_is_owned(x)) {
+    return;
+  }
+
+  sexp* owned = KEEP(vec_rep_payload(constant_data(x), constant_size(x)));
+  R_set_altrep_data1(x, owned);
+  r_dbl_deref(R_altrep_data2(x))[CONSTANT_OWNED] = 1;
+
+  FREE(1);
+}
+
+
+static
+R_xlen_t constant_length(sexp* x) {
+  return constant_size(x);
+}
+
+static
+Rboolean constant_inspect(sexp* x,
+                          int pre,
+                          int deep,
+                          int pvec,
+                          void (*inspect_subtree)(sexp*, int, int, int)) {
+  Rprintf("rlang_constant (size=%" R_PRIdXLEN_T ", owned=%d)\n",
+          (R_xlen_t) constant_size(x),
+          (int) constant_is_owned(x));
+  inspect_subtree(constant_data(x), pre, deep, pvec);
+  return TRUE;
+}
+
+// Duplicates stay compact. R copies the attributes.
+static
+sexp* constant_duplicate(sexp* x, Rboolean deep) {
+  sexp* data = constant_data(x);
+  r_ssize n = constant_size(x);
+
+  if (constant_is_owned(x)) {
+    return r_copy(data);
+  }
+
+  R_altrep_class_t cls;
+  constant_class(r_typeof(data), &cls);
+  return new_constant(cls, data, n);
+}
+
+static
+void* constant_dataptr(sexp* x, Rboolean writeable) {
+  constant_materialise(x);
+  return DATAPTR(constant_data(x));
+}
+
+static
+const void* constant_dataptr_or_null(sexp* x) {
+  if (constant_is_owned(x)) {
+    return DATAPTR_OR_NULL(constant_data(x));
+  } else {
+    return NULL;
+  }
+}
+
+
+#define CONSTANT_ELT(ELT)                               \
+  sexp* data = constant_data(x);                        \
+  return ELT(data, constant_is_owned(x) ? i : 0)
+
+#define CONSTANT_GET_REGION(CTYPE, GET_REGION, ELT)     \
+  sexp* data = constant_data(x);                        \
+  if (constant_is_owned(x)) {                           \
+    return GET_REGION(data, i, n, buf);                 \
+  }                                                     \
+                                                        \
+  r_ssize size = constant_size(x);                      \
+  if (i >= size) {                                      \
+    return 0;                                           \
+  }                                                     \
+  n = r_ssize_min(n, size - i);                         \
+                                                        \
+  const CTYPE value = ELT(data, 0);                     \
+  for (R_xlen_t j = 0; j < n; ++j) {                    \
+    buf[j] = value;                                     \
+  }                                                     \
+  return n
+
+#define CONSTANT_NO_NA(ELT, IS_NA)                      \
+  if (constant_is_owned(x)) {                           \
+    return 0;                                           \
+  }                                                     \
+  return !IS_NA(ELT(constant_data(x), 0))
+
+#define INT_IS_NA(X) ((X) == r_ints_na)
+#define CHR_IS_NA(X) ((X) == r_strs_na)
+
+static int constant_lgl_elt(sexp* x, R_xlen_t i) { CONSTANT_ELT(LOGICAL_ELT); }
+static int constant_int_elt(sexp* x, R_xlen_t i) { CONSTANT_ELT(INTEGER_ELT); }
+static double constant_dbl_elt(sexp* x, R_xlen_t i) { CONSTANT_ELT(REAL_ELT); }
+static sexp* constant_chr_elt(sexp* x, R_xlen_t i) { CONSTANT_ELT(STRING_ELT); }
+
+static R_xlen_t constant_lgl_get_region(sexp* x, R_xlen_t i, R_xlen_t n, int* buf) {
+  CONSTANT_GET_REGION(int, LOGICAL_GET_REGION, LOGICAL_ELT);
+}
+static R_xlen_t constant_int_get_region(sexp* x, R_xlen_t i, R_xlen_t n, int* buf) {
+  CONSTANT_GET_REGION(int, INTEGER_GET_REGION, INTEGER_ELT);
+}
+static R_xlen_t constant_dbl_get_region(sexp* x, R_xlen_t i, R_xlen_t n, double* buf) {
+  CONSTANT_GET_REGION(double, REAL_GET_REGION, REAL_ELT);
+}
+
+static int constant_lgl_no_na(sexp* x) { CONSTANT_NO_NA(LOGICAL_ELT, INT_IS_NA); }
+static int constant_int_no_na(sexp* x) { CONSTANT_NO_NA(INTEGER_ELT, INT_IS_NA); }
+static int constant_dbl_no_na(sexp* x) { CONSTANT_NO_NA(REAL_ELT, ISNAN); }
+static int constant_chr_no_na(sexp* x) { CONSTANT_NO_NA(STRING_ELT, CHR_IS_NA); }
+
+#undef CONSTANT_ELT
+#undef CONSTANT_GET_REGION
+#undef CONSTANT_NO_NA
+#undef INT_IS_NA
+#undef CHR_IS_NA
+
+static
+void constant_chr_set_elt(sexp* x, R_xlen_t i, sexp* value) {
+  constant_materialise(x);
+  r_chr_poke(constant_data(x), i, value);
+}
+
+
+static
+void constant_init_methods(R_altrep_class_t cls) {
+  R_set_altrep_Length_method(cls, constant_length);
+  R_set_altrep_Inspect_method(cls, constant_inspect);
+  R_set_altrep_Duplicate_method(cls, constant_duplicate);
+  R_set_altvec_Dataptr_method(cls, constant_dataptr);
+  R_set_altvec_Dataptr_or_null_method(cls, constant_dataptr_or_null);
+}
+
+void rlang_init_vec_constant(DllInfo* dll) {
+  constant_lgl_class = R_make_altlogical_class("rlang_constant_lgl", "rlang", dll);
+  constant_init_methods(constant_lgl_class);
+  R_set_altlogical_Elt_method(constant_lgl_class, constant_lgl_elt);
+  R_set_altlogical_Get_region_method(constant_lgl_class, constant_lgl_get_region);
+  R_set_altlogical_No_NA_method(constant_lgl_class, constant_lgl_no_na);
+
+  constant_int_class = R_make_altinteger_class("rlang_constant_int", "rlang", dll);
+  constant_init_methods(constant_int_class);
+  R_set_altinteger_Elt_method(constant_int_class, constant_int_elt);
+  R_set_altinteger_Get_region_method(constant_int_class, constant_int_get_region);
+  R_set_altinteger_No_NA_method(constant_int_class, constant_int_no_na);
+
+  constant_dbl_class = R_make_altreal_class("rlang_constant_dbl", "rlang", dll);
+  constant_init_methods(constant_dbl_class);
+  R_set_altreal_Elt_method(constant_dbl_class, constant_dbl_elt);
+  R_set_altreal_Get_region_method(constant_dbl_class, constant_dbl_get_region);
+  R_set_altreal_No_NA_method(constant_dbl_class, constant_dbl_no_na);
+
+  constant_chr_class = R_make_altstring_class("rlang_constant_chr", "rlang", dll);
+  constant_init_methods(constant_chr_class);
+  R_set_altstring_Elt_method(constant_chr_class, constant_chr_elt);
+  R_set_altstring_Set_elt_method(constant_chr_class, constant_chr_set_elt);
+  R_set_altstring_No_NA_method(constant_chr_class, constant_chr_no_na);
+}
+
+#else
+
+void rlang_init_vec_constant(DllInfo* dll) { }
+
+#endif
+
+
+sexp* r_vec_constant(sexp* x, r_ssize n) {
+  if (r_length(x) != 1) {
+    r_abort("Internal error in `r_vec_constant()`: `x` must be a scalar.");
+  }
+  if (n < 0) {
+    r_abort("Internal error in `r_vec_constant()`: `n` must be positive.");
+  }
+
+#if RLANG_HAS_ALTREP
+  R_altrep_class_t cls;
+  if (n >= CONSTANT_MIN_SIZE && constant_class(r_typeof(x), &cls)) {
+    // Don't keep the attributes of `x` alive through the scalar
+    if (r_attrib(x) != r_null) {
+      x = vec_rep_payload(x, 1);
+    }
+    KEEP(x);
+    sexp* out = new_constant(cls, x, n);
+    FREE(1);
+    return out;
+  }
+#endif
+
+  return vec_rep_payload(x, n);
+}
+
+sexp* rlang_vec_constant(sexp* x, sexp* n) {
+  return r_vec_constant(x, r_as_ssize(n));
+}
+
+// Repeats the first element of `x` in a new vector without attributes
+static
+sexp* vec_rep_payload(sexp* x, r_ssize n) {
+  enum r_type type = r_typeof(x);
+  sexp* out = KEEP(r_new_vector(type, n));
+
+  switch (type) {
+  case r_type_logical: {
+    int value = r_lgl_get(x, 0);
+    int* p_out = r_lgl_deref(out);
+    for (r_ssize i = 0; i < n; ++i) p_out[i] = value;
+    break;
+  }
+  case r_type_integer: {
+    int value = r_int_get(x, 0);
+    int* p_out = r_int_deref(out);
+    for (r_ssize i = 0; i < n; ++i) p_out[i] = value;
+    break;
+  }
+  case r_type_double: {
+    double value = r_dbl_get(x, 0);
+    double* p_out = r_dbl_deref(out);
+    for (r_ssize i = 0; i < n; ++i) p_out[i] = value;
+    break;
+  }
+  case r_type_complex: {
+    r_complex_t value = r_cpl_get(x, 0);
+    r_complex_t* p_out = r_cpl_deref(out);
+    for (r_ssize i = 0; i < n; ++i) p_out[i] = value;
+    break;
+  }
+  case r_type_raw: {
+    const unsigned char* p_x = r_raw_deref_const(x);
+    memset(r_raw_deref(out), p_x[0], n);
+    break;
+  }
+  case r_type_character: {
+    sexp* value = r_chr_get(x, 0);
+    if (value != r_strs_empty) {
+      r_chr_fill(out, value);
+    }
+    break;
+  }
+  case r_type_list:
+  case r_type_expression: {
+    sexp* value = r_list_get(x, 0);
+    for (r_ssize i = 0; i < n; ++i) r_list_poke(out, i, value);
+    break;
+  }
+  default:
+    r_stop_unimplemented_type("r_vec_constant", type);
+  }
+
+  FREE(1);
+  return out;
+}
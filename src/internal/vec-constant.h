@@ -0,0 +1,8 @@
+#ifndef RLANG_INTERNAL_VEC_CONSTANT_H
+#define RLANG_INTERNAL_VEC_CONSTANT_H
+
+
+sexp* r_vec_constant(sexp* x, r_ssize n);
+
+
+#endif
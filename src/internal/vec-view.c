@@ -0,0 +1,337 @@
+#include <rlang.h>
+#include <R_ext/Rdynload.h>
+#include "altrep.h"
+#include "vec-view.h"
+
+/**
+ * Views are ALTREP vectors representing a contiguous slice of another
+ * vector without copying it. Reading from a view reads from the
+ * underlying vector. A writable pointer is only handed out after the
+ * slice has been materialised in a vector owned by the view, so that
+ * the underlying vector is never modified.
+ *
+ * The `data1` slot contains the underlying vector. The `data2` slot
+ * is a double vector containing the start offset, the size, and
+ * whether `data1` is owned by the view (i.e. has been materialised).
+ */
+
+static sexp* slice_call = NULL;
+
+#define VIEW_START 0
+#define VIEW_SIZE 1
+#define VIEW_OWNED 2
+
+static sexp* vec_slice_copy(sexp* x, r_ssize start, r_ssize size);
+static sexp* vec_slice_payload(sexp* x, r_ssize start, r_ssize size);
+static bool is_viewable(sexp* x);
+
+
+#if RLANG_HAS_ALTREP
+
+static R_altrep_class_t view_lgl_class;
+static R_altrep_class_t view_int_class;
+static R_altrep_class_t view_dbl_class;
+static R_altrep_class_t view_cpl_class;
+static R_altrep_class_t view_raw_class;
+static R_altrep_class_t view_chr_class;
+
+static inline
+sexp* view_data(sexp* x) {
+  return R_altrep_data1(x);
+}
+static inline
+r_ssize view_start(sexp* x) {
+  return (r_ssize) r_dbl_get(R_altrep_data2(x), VIEW_START);
+}
+static inline
+r_ssize view_size(sexp* x) {
+  return (r_ssize) r_dbl_get(R_altrep_data2(x), VIEW_SIZE);
+}
+static inline
+bool view_is_owned(sexp* x) {
+  return r_dbl_get(R_altrep_data2(x), VIEW_OWNED);
+}
+
+static
+sexp* new_view(sexp* x, r_ssize start, r_ssize size) {
+  R_altrep_class_t cls;
+
+  switch (r_typeof(x)) {
+  case r_type_logical: cls = view_lgl_class; break;
+  case r_type_integer: cls = view_int_class; break;
+  case r_type_double: cls = view_dbl_class; break;
+  case r_type_complex: cls = view_cpl_class; break;
+  case r_type_raw: cls = view_raw_class; break;
+  case r_type_character: cls = view_chr_class; break;
+  default: r_stop_unimplemented_type("new_view", r_typeof(x));
+  }
+
+  // Views of views point to the original vector
+  if (ALTREP(x) && R_altrep_inherits(x, cls) && !view_is_owned(x)) {
+    start += view_start(x);
+    x = view_data(x);
+  }
+
+  sexp* info = KEEP(r_new_double(3));
+  double* p_info = r_dbl_deref(info);
+  p_info[VIEW_START] = start;
+  p_info[VIEW_SIZE] = size;
+  p_info[VIEW_OWNED] = 0;
+
+  sexp* out = R_new_altrep(cls, x, info);
+
+  FREE(1);
+  return out;
+}
+
+// Copies the slice into a vector owned by the view. From then on
+// the view can be freely modified.
+static
+void view_materialise(sexp* x) {
+  if (view_is_owned(x)) {
+    return;
+  }
+
+  sexp* owned = KEEP(vec_slice_payload(view_data(x), view_start(x), view_size(x)));
+  R_set_altrep_data1(x, owned);
+
+  double* p_info = r_dbl_deref(R_altrep_data2(x));
+  p_info[VIEW_START] = 0;
+  p_info[VIEW_OWNED] = 1;
+
+  FREE(1);
+}
+
+
+static
+R_xlen_t view_length(sexp* x) {
+  return view_size(x);
+}
+
+static
+Rboolean view_inspect(sexp* x,
+                      int pre,
+                      int deep,
+                      int pvec,
+                      void (*inspect_subtree)(sexp*, int, int, int)) {
+  Rprintf("rlang_view (start=%" R_PRIdXLEN_T ", size=%" R_PRIdXLEN_T ", owned=%d)\n",
+          (R_xlen_t) view_start(x),
+          (R_xlen_t) view_size(x),
+          (int) view_is_owned(x));
+  inspect_subtree(view_data(x), pre, deep, pvec);
+  return TRUE;
+}
+
+// R copies the attributes of the view
+static
+sexp* view_duplicate(sexp* x, Rboolean deep) {
+  return vec_slice_payload(view_data(x), view_start(x), view_size(x));
+}
+
+static
+void* view_dataptr(sexp* x, Rboolean writeable) {
+  if (writeable) {
+    view_materialise(x);
+    return DATAPTR(view_data(x));
+  }
+
+  sexp* data = view_data(x);
+  const unsigned char* p_data = DATAPTR_RO(data);
+  return (void*) (p_data + view_start(x) * r_vec_elt_sizeof(data));
+}
+
+static
+const void* view_dataptr_or_null(sexp* x) {
+  sexp* data = view_data(x);
+
+  const unsigned char* p_data = DATAPTR_OR_NULL(data);
+  if (p_data == NULL) {
+    return NULL;
+  }
+
+  return p_data + view_start(x) * r_vec_elt_sizeof(data);
+}
+
+
+#define VIEW_ELT(ELT)                           \
+  return ELT(view_data(x), view_start(x) + i)
+
+#define VIEW_GET_REGION(GET_REGION)                             \
+  r_ssize size = view_size(x);                                  \
+  if (i >= size) {                                              \
+    return 0;                                                   \
+  }                                                             \
+  n = r_ssize_min(n, size - i);                                 \
+  return GET_REGION(view_data(x), view_start(x) + i, n, buf)
+
+static int view_lgl_elt(sexp* x, R_xlen_t i) { VIEW_ELT(LOGICAL_ELT); }
+static int view_int_elt(sexp* x, R_xlen_t i) { VIEW_ELT(INTEGER_ELT); }
+static double view_dbl_elt(sexp* x, R_xlen_t i) { VIEW_ELT(REAL_ELT); }
+static Rcomplex view_cpl_elt(sexp* x, R_xlen_t i) { VIEW_ELT(COMPLEX_ELT); }
+static Rbyte view_raw_elt(sexp* x, R_xlen_t i) { VIEW_ELT(RAW_ELT); }
+static sexp* view_chr_elt(sexp* x, R_xlen_t i) { VIEW_ELT(STRING_ELT); }
+
+static R_xlen_t view_lgl_get_region(sexp* x, R_xlen_t i, R_xlen_t n, int* buf) {
+  VIEW_GET_REGION(LOGICAL_GET_REGION);
+}
+static R_xlen_t view_int_get_region(sexp* x, R_xlen_t i, R_xlen_t n, int* buf) {
+  VIEW_GET_REGION(INTEGER_GET_REGION);
+}
+static R_xlen_t view_dbl_get_region(sexp* x, R_xlen_t i, R_xlen_t n, double* buf) {
+  VIEW_GET_REGION(REAL_GET_REGION);
+}
+static R_xlen_t view_cpl_get_region(sexp* x, R_xlen_t i, R_xlen_t n, Rcomplex* buf) {
+  VIEW_GET_REGION(COMPLEX_GET_REGION);
+}
+static R_xlen_t view_raw_get_region(sexp* x, R_xlen_t i, R_xlen_t n, Rbyte* buf) {
+  VIEW_GET_REGION(RAW_GET_REGION);
+}
+
+#undef VIEW_ELT
+#undef VIEW_GET_REGION
+
+static
+void view_chr_set_elt(sexp* x, R_xlen_t i, sexp* value) {
+  view_materialise(x);
+  r_chr_poke(view_data(x), i, value);
+}
+
+
+static
+void view_init_methods(R_altrep_class_t cls) {
+  R_set_altrep_Length_method(cls, view_length);
+  R_set_altrep_Inspect_method(cls, view_inspect);
+  R_set_altrep_Duplicate_method(cls, view_duplicate);
+  R_set_altvec_Dataptr_method(cls, view_dataptr);
+  R_set_altvec_Dataptr_or_null_method(cls, view_dataptr_or_null);
+}
+
+void rlang_init_vec_view(DllInfo* dll) {
+  view_lgl_class = R_make_altlogical_class("rlang_view_lgl", "rlang", dll);
+  view_init_methods(view_lgl_class);
+  R_set_altlogical_Elt_method(view_lgl_class, view_lgl_elt);
+  R_set_altlogical_Get_region_method(view_lgl_class, view_lgl_get_region);
+
+  view_int_class = R_make_altinteger_class("rlang_view_int", "rlang", dll);
+  view_init_methods(view_int_class);
+  R_set_altinteger_Elt_method(view_int_class, view_int_elt);
+  R_set_altinteger_Get_region_method(view_int_class, view_int_get_region);
+
+  view_dbl_class = R_make_altreal_class("rlang_view_dbl", "rlang", dll);
+  view_init_methods(view_dbl_class);
+  R_set_altreal_Elt_method(view_dbl_class, view_dbl_elt);
+  R_set_altreal_Get_region_method(view_dbl_class, view_dbl_get_region);
+
+  view_cpl_class = R_make_altcomplex_class("rlang_view_cpl", "rlang", dll);
+  view_init_methods(view_cpl_class);
+  R_set_altcomplex_Elt_method(view_cpl_class, view_cpl_elt);
+  R_set_altcomplex_Get_region_method(view_cpl_class, view_cpl_get_region);
+
+  view_raw_class = R_make_altraw_class("rlang_view_raw", "rlang", dll);
+  view_init_methods(view_raw_class);
+  R_set_altraw_Elt_method(view_raw_class, view_raw_elt);
+  R_set_altraw_Get_region_method(view_raw_class, view_raw_get_region);
+
+  view_chr_class = R_make_altstring_class("rlang_view_chr", "rlang", dll);
+  view_init_methods(view_chr_class);
+  R_set_altstring_Elt_method(view_chr_class, view_chr_elt);
+  R_set_altstring_Set_elt_method(view_chr_class, view_chr_set_elt);
+}
+
+#else
+
+void rlang_init_vec_view(DllInfo* dll) { }
+
+#endif
+
+
+sexp* r_vec_view(sexp* x, r_ssize start, r_ssize size) {
+  if (start < 0 || size < 0 || start + size > r_length(x)) {
+    r_abort("Internal error in `r_vec_view()`: Slice is out of bounds.");
+  }
+
+  if (!is_viewable(x)) {
+    return vec_slice_copy(x, start, size);
+  }
+
+#if RLANG_HAS_ALTREP
+  sexp* out = KEEP(new_view(x, start, size));
+
+  sexp* attrib = r_attrib(x);
+  if (attrib != r_null) {
+    r_poke_attrib(out, r_clone(attrib));
+    SET_OBJECT(out, OBJECT(x));
+
+    sexp* names = r_names(x);
+    if (names != r_null) {
+      r_attrib_poke_names(out, r_vec_view(names, start, size));
+    }
+  }
+
+  FREE(1);
+  return out;
+#else
+  return vec_slice_copy(x, start, size);
+#endif
+}
+
+static
+bool is_viewable(sexp* x) {
+  switch (r_typeof(x)) {
+  case r_type_logical:
+  case r_type_integer:
+  case r_type_double:
+  case r_type_complex:
+  case r_type_raw:
+  case r_type_character:
+    break;
+  default:
+    return false;
+  }
+
+  if (r_attrib_get(x, R_DimSymbol) != r_null) {
+    return false;
+  }
+  if (!OBJECT(x)) {
+    return true;
+  }
+
+  // Only classes whose `[` method preserves all attributes
+  return Rf_inherits(x, "factor") || Rf_inherits(x, "Date") ||
+    Rf_inherits(x, "POSIXct") || Rf_inherits(x, "difftime");
+}
+
+// Copies the elements of an atomic vector without its attributes
+static
+sexp* vec_slice_payload(sexp* x, r_ssize start, r_ssize size) {
+  sexp* out = KEEP(r_new_vector(r_typeof(x), size));
+  r_vec_poke_n(out, 0, x, start, size);
+  FREE(1);
+  return out;
+}
+
+// Bare vectors are copied directly. Other objects are sliced with
+// `[` to preserve their class invariants.
+static
+sexp* vec_slice_copy(sexp* x, r_ssize start, r_ssize size) {
+  if (r_attrib(x) == r_null && r_is_atomic(x, -1)) {
+    return vec_slice_payload(x, start, size);
+  }
+
+  sexp* idx = KEEP(r_new_double(size));
+  double* p_idx = r_dbl_deref(idx);
+  for (r_ssize i = 0; i < size; ++i) {
+    p_idx[i] = start + i + 1;
+  }
+
+  sexp* out = r_eval_with_xy(slice_call, x, idx, r_base_env);
+
+  FREE(1);
+  return out;
+}
+
+
+void rlang_init_vec_view_slice() {
+  slice_call = r_parse("x[y]");
+  r_preserve(slice_call);
+}
@@ -0,0 +1,8 @@
+#ifndef RLANG_INTERNAL_VEC_VIEW_H
+#define RLANG_INTERNAL_VEC_VIEW_H
+
+
+sexp* r_vec_view(sexp* x, r_ssize start, r_ssize size);
+
+
+#endif
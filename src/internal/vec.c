@@ -39,6 +39,36 @@ bool r_is_logical(sexp* x, r_ssize n) {
   return r_typeof(x) == r_type_logical && has_correct_length(x, n);
 }
 
+/**
+ * The scans below work on blocks of doubles. Within a block, the
+ * checks are accumulated without branching so that the compiler can
+ * vectorise them. The scans still exit early, at block granularity.
+ */
+#define RLANG_SCAN_BLOCK 8
+
+static
+bool dbl_has_non_finite(const double* p_x, r_ssize n) {
+  r_ssize i = 0;
+
+  for (; i + RLANG_SCAN_BLOCK <= n; i += RLANG_SCAN_BLOCK) {
+    int non_finite = 0;
+    for (int j = 0; j < RLANG_SCAN_BLOCK; ++j) {
+      non_finite |= !isfinite(p_x[i + j]);
+    }
+    if (non_finite) {
+      return true;
+    }
+  }
+
+  for (; i < n; ++i) {
+    if (!isfinite(p_x[i])) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 bool r_is_finite(sexp* x) {
   r_ssize n = r_length(x);
 
@@ -54,19 +84,16 @@ bool r_is_finite(sexp* x) {
   }
   case r_type_double: {
     const double* p_x = r_dbl_deref_const(x);
-    for (r_ssize i = 0; i < n; ++i) {
-      if (!isfinite(p_x[i])) {
-        return false;
-      }
+    if (dbl_has_non_finite(p_x, n)) {
+      return false;
     }
     break;
   }
   case r_type_complex: {
-    const r_complex_t* p_x = r_cpl_deref_const(x);
-    for (r_ssize i = 0; i < n; ++i) {
-      if (!isfinite(p_x[i].r) || !isfinite(p_x[i].i)) {
-        return false;
-      }
+    // Complex vectors are scanned as interleaved real and imaginary parts
+    const double* p_x = (const double*) r_cpl_deref_const(x);
+    if (dbl_has_non_finite(p_x, r_ssize_mult(n, 2))) {
+      return false;
     }
     break;
   }
@@ -99,6 +126,15 @@ bool r_is_double(sexp* x, r_ssize n, int finite) {
 // support is enabled
 #define RLANG_MAX_DOUBLE_INT 4503599627370496
 
+// Negative doubles below -2^63 don't round-trip through a 64-bit integer
+#define RLANG_MIN_DOUBLE_INT -9223372036854775808.0
+
+// Only called on finite doubles
+static inline
+int dbl_is_whole(double x) {
+  return (x <= RLANG_MAX_DOUBLE_INT) & (x >= RLANG_MIN_DOUBLE_INT) & (x == trunc(x));
+}
+
 bool r_is_integerish(sexp* x, r_ssize n, int finite) {
   if (r_typeof(x) == r_type_integer) {
     return r_is_integer(x, n, finite);
@@ -111,21 +147,38 @@ bool r_is_integerish(sexp* x, r_ssize n, int finite) {
   const double* p_x = r_dbl_deref_const(x);
   bool actual_finite = true;
 
-  for (r_ssize i = 0; i < actual_n; ++i) {
-    double elt = p_x[i];
+  r_ssize i = 0;
 
-    if (!isfinite(elt)) {
-      actual_finite = false;
-      continue;
+  for (; i + RLANG_SCAN_BLOCK <= actual_n; i += RLANG_SCAN_BLOCK) {
+    int non_finite = 0;
+    int fractional = 0;
+
+    for (int j = 0; j < RLANG_SCAN_BLOCK; ++j) {
+      double elt = p_x[i + j];
+      int elt_finite = isfinite(elt) != 0;
+      non_finite |= !elt_finite;
+      fractional |= elt_finite & !dbl_is_whole(elt);
     }
 
-    if (elt > RLANG_MAX_DOUBLE_INT) {
+    if (fractional) {
       return false;
     }
+    if (non_finite) {
+      actual_finite = false;
+      if (finite == 1) {
+        return false;
+      }
+    }
+  }
 
-    // C99 guarantees existence of the int_least_N_t types, even on
-    // machines that don't support arithmetic on width N:
-    if (elt != (int_least64_t) elt) {
+  for (; i < actual_n; ++i) {
+    double elt = p_x[i];
+
+    if (!isfinite(elt)) {
+      actual_finite = false;
+      continue;
+    }
+    if (!dbl_is_whole(elt)) {
       return false;
     }
   }
@@ -138,6 +191,8 @@ bool r_is_integerish(sexp* x, r_ssize n, int finite) {
 }
 
 #undef RLANG_MAX_DOUBLE_INT
+#undef RLANG_MIN_DOUBLE_INT
+#undef RLANG_SCAN_BLOCK
 
 bool r_is_character(sexp* x, r_ssize n) {
   return r_typeof(x) == r_type_character && has_correct_length(x, n);
@@ -161,6 +216,142 @@ sexp* rlang_vec_coercer(sexp* dest) {
   }
 }
 
+// Doubles are only cast to integers or logicals when they are whole.
+// Out of range and fractional doubles are left to the R coercers
+// which warn or fail with the proper message.
+#define RLANG_MAX_DOUBLE_INT 4503599627370496
+
+static
+bool poke_lgl_from_int(int* v_x, const int* v_y, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    int elt = v_y[i];
+    v_x[i] = (elt == r_ints_na) ? r_lgls_na : elt != 0;
+  }
+  return true;
+}
+static
+bool poke_lgl_from_dbl(int* v_x, const double* v_y, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    double elt = v_y[i];
+
+    if (isnan(elt)) {
+      v_x[i] = r_lgls_na;
+    } else if (isinf(elt)) {
+      v_x[i] = 1;
+    } else if (fabs(elt) > RLANG_MAX_DOUBLE_INT || elt != trunc(elt)) {
+      return false;
+    } else {
+      v_x[i] = elt != 0;
+    }
+  }
+  return true;
+}
+static
+bool poke_int_from_dbl(int* v_x, const double* v_y, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    double elt = v_y[i];
+
+    if (isnan(elt)) {
+      v_x[i] = r_ints_na;
+    } else if (elt <= INT_MIN || elt > INT_MAX || elt != trunc(elt)) {
+      return false;
+    } else {
+      v_x[i] = (int) elt;
+    }
+  }
+  return true;
+}
+static
+bool poke_dbl_from_int(double* v_x, const int* v_y, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    int elt = v_y[i];
+    v_x[i] = (elt == r_ints_na) ? r_dbls_na : (double) elt;
+  }
+  return true;
+}
+static
+bool poke_cpl_from_int(r_complex_t* v_x, const int* v_y, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    int elt = v_y[i];
+
+    if (elt == r_ints_na) {
+#if (R_VERSION < R_Version(4, 4, 0))
+      v_x[i] = (r_complex_t) { .r = r_dbls_na, .i = r_dbls_na };
+#else
+      v_x[i] = (r_complex_t) { .r = r_dbls_na, .i = 0 };
+#endif
+    } else {
+      v_x[i] = (r_complex_t) { .r = elt, .i = 0 };
+    }
+  }
+  return true;
+}
+static
+bool poke_cpl_from_dbl(r_complex_t* v_x, const double* v_y, r_ssize n) {
+  for (r_ssize i = 0; i < n; ++i) {
+    double elt = v_y[i];
+
+#if (R_VERSION < R_Version(4, 4, 0))
+    // Only `NA` has a missing imaginary part, other NaN values don't
+    if (R_IsNA(elt)) {
+      v_x[i] = (r_complex_t) { .r = r_dbls_na, .i = r_dbls_na };
+      continue;
+    }
+#endif
+
+    v_x[i] = (r_complex_t) { .r = elt, .i = 0 };
+  }
+  return true;
+}
+
+// Coerces the numeric types in place. Returns `false` if the
+// conversion must go through the R coercers.
+static
+bool vec_poke_coerce_native(sexp* x, r_ssize offset,
+                            sexp* y, r_ssize from, r_ssize n) {
+  enum r_type y_type = r_typeof(y);
+
+  switch (r_typeof(x)) {
+  case r_type_logical: {
+    int* v_x = r_lgl_deref(x) + offset;
+    switch (y_type) {
+    case r_type_integer: return poke_lgl_from_int(v_x, r_int_deref_const(y) + from, n);
+    case r_type_double: return poke_lgl_from_dbl(v_x, r_dbl_deref_const(y) + from, n);
+    default: return false;
+    }
+  }
+  case r_type_integer: {
+    int* v_x = r_int_deref(x) + offset;
+    switch (y_type) {
+    case r_type_logical: memcpy(v_x, r_lgl_deref_const(y) + from, n * sizeof(int)); return true;
+    case r_type_double: return poke_int_from_dbl(v_x, r_dbl_deref_const(y) + from, n);
+    default: return false;
+    }
+  }
+  case r_type_double: {
+    double* v_x = r_dbl_deref(x) + offset;
+    switch (y_type) {
+    case r_type_logical: return poke_dbl_from_int(v_x, r_lgl_deref_const(y) + from, n);
+    case r_type_integer: return poke_dbl_from_int(v_x, r_int_deref_const(y) + from, n);
+    default: return false;
+    }
+  }
+  case r_type_complex: {
+    r_complex_t* v_x = r_cpl_deref(x) + offset;
+    switch (y_type) {
+    case r_type_logical: return poke_cpl_from_int(v_x, r_lgl_deref_const(y) + from, n);
+    case r_type_integer: return poke_cpl_from_int(v_x, r_int_deref_const(y) + from, n);
+    case r_type_double: return poke_cpl_from_dbl(v_x, r_dbl_deref_const(y) + from, n);
+    default: return false;
+    }
+  }
+  default:
+    return false;
+  }
+}
+
+#undef RLANG_MAX_DOUBLE_INT
+
 void r_vec_poke_coerce_n(sexp* x, r_ssize offset,
                          sexp* y, r_ssize from, r_ssize n) {
   if (r_typeof(y) == r_typeof(x)) {
@@ -171,7 +362,19 @@ void r_vec_poke_coerce_n(sexp* x, r_ssize offset,
     r_abort("Can't splice S3 objects");
   }
 
-  // FIXME: This callbacks to rlang R coercers with an extra copy.
+  if ((r_length(x) - offset) < n) {
+    r_abort("Can't copy data to `x` because it is too small");
+  }
+  if ((r_length(y) - from) < n) {
+    r_abort("Can't copy data from `y` because it is too small");
+  }
+
+  if (vec_poke_coerce_native(x, offset, y, from, n)) {
+    return;
+  }
+
+  // Character and raw conversions, as well as casts that fail or
+  // lose precision, call back to the rlang R coercers
   sexp* coercer = rlang_vec_coercer(x);
   sexp* call = KEEP(Rf_lang2(coercer, y));
   sexp* coerced = KEEP(r_eval(call, R_BaseEnv));
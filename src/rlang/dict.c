@@ -122,6 +122,21 @@ bool r_dict_put(struct r_dict* p_dict, sexp* key, sexp* value) {
   return true;
 }
 
+// Unlike `r_dict_put()`, this overwrites existing values. Returns the
+// previous value or a C `NULL` if `key` did not exist.
+sexp* r_dict_poke(struct r_dict* p_dict, sexp* key, sexp* value) {
+  sexp* node = dict_find_node(p_dict, key);
+
+  if (node == r_null) {
+    r_dict_put(p_dict, key, value);
+    return NULL;
+  }
+
+  sexp* old = r_node_car(node);
+  r_node_poke_car(node, value);
+  return old;
+}
+
 // Returns `true` if key existed and was deleted. Returns `false` if
 // the key could not be deleted because it did not exist in the dict.
 bool r_dict_del(struct r_dict* p_dict, sexp* key) {
@@ -43,15 +43,22 @@ sexp* rlang_ns_get(const char* name) {
 }
 
 
+#if R_VERSION < R_Version(4, 1, 0)
 static sexp* new_env_call = NULL;
 static sexp* new_env__parent_node = NULL;
 static sexp* new_env__size_node = NULL;
+#endif
 
+// `size` is the number of buckets of the hash table. R grows the
+// table when it is more than 85% full.
 sexp* r_new_environment(sexp* parent, r_ssize size) {
   parent = parent ? parent : r_empty_env;
-  r_node_poke_car(new_env__parent_node, parent);
-
   size = size ? size : 29;
+
+#if R_VERSION >= R_Version(4, 1, 0)
+  return R_NewEnv(parent, TRUE, size);
+#else
+  r_node_poke_car(new_env__parent_node, parent);
   r_node_poke_car(new_env__size_node, r_int(size));
 
   sexp* env = r_eval(new_env_call, r_base_env);
@@ -60,6 +67,7 @@ sexp* r_new_environment(sexp* parent, r_ssize size) {
   r_node_poke_car(new_env__parent_node, r_null);
 
   return env;
+#endif
 }
 
 
@@ -95,10 +103,13 @@ sexp* r_env_as_list_compat(sexp* env, sexp* out) {
   sexp* const * p_nms = r_chr_deref_const(nms);
   const int* p_types = r_int_deref_const(types);
 
+  struct r_chr_index* p_out_nms = r_new_chr_index(r_names(out));
+  KEEP(p_out_nms->shelter);
+
   for (r_ssize i = 0; i < n; ++i) {
     enum r_env_binding_type type = p_types[i];
     if (type == R_ENV_BINDING_ACTIVE) {
-      r_ssize fn_idx = r_chr_detect_index(nms, r_str_c_string(p_nms[i]));
+      r_ssize fn_idx = r_chr_index_get(p_out_nms, p_nms[i]);
       if (fn_idx < 0) {
         r_abort("Internal error: Can't find active binding in list");
       }
@@ -110,7 +121,7 @@ sexp* r_env_as_list_compat(sexp* env, sexp* out) {
     }
   }
 
-  FREE(2);
+  FREE(3);
   return out;
 }
 
@@ -119,11 +130,87 @@ sexp* r_list_as_environment(sexp* x, sexp* parent) {
   return eval_with_xy(list2env_call, x, parent);
 }
 
+static void env_clone_frame(sexp* env, sexp* frame, sexp* out);
+static sexp* env_clone_roundtrip(sexp* env, sexp* parent);
+static sexp* env_clone_promise(sexp* x);
+
+// Copies the bindings by walking the frame list or the hash table
+// chains. Promises are copied unforced and active bindings are
+// copied as active bindings.
 sexp* r_env_clone(sexp* env, sexp* parent) {
   if (parent == NULL) {
     parent = r_env_parent(env);
   }
 
+  // The bindings of the base environment live in the symbol table
+  // and user databases provide their own storage
+  if (env == r_base_env ||
+      env == R_BaseNamespace ||
+      r_inherits(env, "UserDefinedDatabase")) {
+    return env_clone_roundtrip(env, parent);
+  }
+
+  sexp* table = HASHTAB(env);
+
+  if (table == r_null) {
+    r_ssize n = r_env_length(env);
+    r_ssize size = n ? r_ssize_max(29, n + n / 4) : 0;
+    sexp* out = KEEP(r_new_environment(parent, size));
+
+    env_clone_frame(env, FRAME(env), out);
+
+    FREE(1);
+    return out;
+  }
+
+  r_ssize n = r_length(table);
+  sexp* out = KEEP(r_new_environment(parent, n));
+
+  for (r_ssize i = 0; i < n; ++i) {
+    env_clone_frame(env, r_list_get(table, i), out);
+  }
+
+  FREE(1);
+  return out;
+}
+
+static
+void env_clone_frame(sexp* env, sexp* frame, sexp* out) {
+  for (; frame != r_null; frame = r_node_cdr(frame)) {
+    sexp* sym = r_node_tag(frame);
+
+    if (R_BindingIsActive(sym, env)) {
+      // The cell of an active binding holds its function
+      R_MakeActiveBinding(sym, r_node_car(frame), out);
+    } else {
+      // Don't read the cell directly as values can be stored unboxed
+      sexp* value = r_env_find(env, sym);
+
+      if (r_typeof(value) == r_type_promise) {
+        value = env_clone_promise(value);
+      }
+
+      KEEP(value);
+      Rf_defineVar(sym, value, out);
+      FREE(1);
+    }
+  }
+}
+
+// The clone gets its own promise so that forcing a binding in one
+// environment doesn't force it in the other. Forced promises are
+// replaced by their value.
+static
+sexp* env_clone_promise(sexp* x) {
+  sexp* value = PRVALUE(x);
+  if (value != r_syms_unbound) {
+    return value;
+  }
+  return Rf_mkPROMISE(PRCODE(x), PRENV(x));
+}
+
+static
+sexp* env_clone_roundtrip(sexp* env, sexp* parent) {
   sexp* out = KEEP(r_env_as_list(env));
   out = r_list_as_environment(out, parent);
 
@@ -194,11 +281,13 @@ void r_init_rlang_ns_env() {
 sexp* r_methods_ns_env = NULL;
 
 void r_init_library_env() {
+#if R_VERSION < R_Version(4, 1, 0)
   new_env_call = r_parse_eval("as.call(list(new.env, TRUE, NULL, NULL))", r_base_env);
   r_preserve(new_env_call);
 
   new_env__parent_node = r_node_cddr(new_env_call);
   new_env__size_node = r_node_cdr(new_env__parent_node);
+#endif
 
   env2list_call = r_parse("as.list.environment(x, all.names = TRUE)");
   r_preserve(env2list_call);
@@ -25,17 +25,205 @@ bool r_chr_has_any(sexp* chr, const char** c_strings) {
   for (r_ssize i = 0; i != n; ++i) {
     const char* cur = CHAR(r_chr_get(chr, i));
 
-    while (*c_strings) {
-      if (strcmp(cur, *c_strings) == 0) {
+    for (const char** p_c_string = c_strings; *p_c_string; ++p_c_string) {
+      if (strcmp(cur, *p_c_string) == 0) {
         return true;
       }
-      ++c_strings;
     }
   }
 
   return false;
 }
 
+
+struct r_chr_index_slot {
+  // A C `NULL` marks an empty slot
+  sexp* key;
+  r_ssize i;
+};
+
+static bool str_needs_translation(sexp* str);
+static sexp* str_as_utf8(sexp* str);
+static void chr_index_insert(struct r_chr_index* p_index, sexp* key, r_ssize i);
+static r_ssize chr_index_find(struct r_chr_index* p_index, sexp* key);
+
+struct r_chr_index* r_new_chr_index(sexp* chr) {
+  if (r_typeof(chr) != r_type_character) {
+    r_stop_internal("r_new_chr_index", "`chr` must be a character vector.");
+  }
+
+  r_ssize n = r_length(chr);
+  sexp* const * p_chr = r_chr_deref_const(chr);
+
+  r_ssize n_translations = 0;
+  for (r_ssize i = 0; i < n; ++i) {
+    n_translations += str_needs_translation(p_chr[i]);
+  }
+
+  // Keep the load factor below 0.5 for short probe sequences
+  r_ssize n_slots = 8;
+  while (n_slots < 2 * (n + n_translations)) {
+    n_slots <<= 1;
+  }
+
+  sexp* shelter = KEEP(r_new_list(4));
+
+  sexp* index_raw = r_new_raw(sizeof(struct r_chr_index));
+  r_list_poke(shelter, 0, index_raw);
+
+  struct r_chr_index* p_index = r_raw_deref(index_raw);
+  memset(p_index, 0, sizeof(struct r_chr_index));
+  p_index->shelter = shelter;
+
+  sexp* slots = r_new_raw(n_slots * sizeof(struct r_chr_index_slot));
+  r_list_poke(shelter, 1, slots);
+
+  p_index->p_slots = r_raw_deref(slots);
+  p_index->n_slots = n_slots;
+  memset(p_index->p_slots, 0, n_slots * sizeof(struct r_chr_index_slot));
+
+  // Protect the indexed strings
+  r_list_poke(shelter, 2, chr);
+
+  sexp* translations = r_null;
+  if (n_translations) {
+    translations = r_new_list(n_translations);
+    r_list_poke(shelter, 3, translations);
+  }
+
+  for (r_ssize i = 0, j = 0; i < n; ++i) {
+    sexp* str = p_chr[i];
+    chr_index_insert(p_index, str, i);
+
+    if (str_needs_translation(str)) {
+      sexp* translated = str_as_utf8(str);
+      r_list_poke(translations, j++, translated);
+      chr_index_insert(p_index, translated, i);
+    }
+  }
+
+  FREE(1);
+  return p_index;
+}
+
+r_ssize r_chr_index_get(struct r_chr_index* p_index, sexp* str) {
+  r_ssize i = chr_index_find(p_index, str);
+  if (i >= 0 || !str_needs_translation(str)) {
+    return i;
+  }
+
+  // Equal strings in different encodings don't share a pointer
+  sexp* translated = KEEP(str_as_utf8(str));
+  i = chr_index_find(p_index, translated);
+
+  FREE(1);
+  return i;
+}
+
+static
+r_ssize chr_find(sexp* const * p_chr, r_ssize n, sexp* key) {
+  for (r_ssize i = 0; i < n; ++i) {
+    sexp* str = p_chr[i];
+    if (str == key) {
+      return i;
+    }
+    if (str_needs_translation(str) && str_as_utf8(str) == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+r_ssize r_chr_find(sexp* chr, sexp* str) {
+  r_ssize n = r_length(chr);
+  sexp* const * p_chr = r_chr_deref_const(chr);
+
+  r_ssize i = chr_find(p_chr, n, str);
+  if (i >= 0 || !str_needs_translation(str)) {
+    return i;
+  }
+
+  sexp* translated = KEEP(str_as_utf8(str));
+  i = chr_find(p_chr, n, translated);
+
+  FREE(1);
+  return i;
+}
+
+r_ssize r_chr_index_get_c_string(struct r_chr_index* p_index, const char* c_string) {
+  sexp* str = KEEP(r_str(c_string));
+  r_ssize i = r_chr_index_get(p_index, str);
+  FREE(1);
+  return i;
+}
+
+static inline
+r_ssize chr_index_hash(struct r_chr_index* p_index, sexp* key) {
+  uint64_t hash = r_xxh3_64bits(&key, sizeof(sexp*));
+  return hash & (p_index->n_slots - 1);
+}
+
+// Only the first occurrence of a string is indexed
+static
+void chr_index_insert(struct r_chr_index* p_index, sexp* key, r_ssize i) {
+  struct r_chr_index_slot* p_slots = p_index->p_slots;
+  r_ssize mask = p_index->n_slots - 1;
+
+  for (r_ssize j = chr_index_hash(p_index, key); ; j = (j + 1) & mask) {
+    if (p_slots[j].key == key) {
+      return;
+    }
+    if (p_slots[j].key == NULL) {
+      p_slots[j].key = key;
+      p_slots[j].i = i;
+      return;
+    }
+  }
+}
+
+static
+r_ssize chr_index_find(struct r_chr_index* p_index, sexp* key) {
+  struct r_chr_index_slot* p_slots = p_index->p_slots;
+  r_ssize mask = p_index->n_slots - 1;
+
+  for (r_ssize j = chr_index_hash(p_index, key); ; j = (j + 1) & mask) {
+    if (p_slots[j].key == key) {
+      return p_slots[j].i;
+    }
+    if (p_slots[j].key == NULL) {
+      return -1;
+    }
+  }
+}
+
+static
+bool str_needs_translation(sexp* str) {
+  if (str == r_strs_na) {
+    return false;
+  }
+
+  switch (Rf_getCharCE(str)) {
+  case CE_UTF8:
+  case CE_BYTES:
+    return false;
+  default:
+    break;
+  }
+
+  for (const char* p = CHAR(str); *p; ++p) {
+    if ((unsigned char) *p > 127) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static
+sexp* str_as_utf8(sexp* str) {
+  return Rf_mkCharCE(Rf_translateCharUTF8(str), CE_UTF8);
+}
+
+
 void r_chr_fill(sexp* chr, sexp* value) {
   r_ssize n = r_length(chr);
   for (r_ssize i = 0; i < n; ++i) {
@@ -16,6 +16,41 @@ r_ssize r_chr_detect_index(sexp* chr, const char* c_string);
 void r_chr_fill(sexp* chr, sexp* value);
 
 
+/**
+ * An index over the strings of a character vector for repeated
+ * lookups in constant time. R caches strings globally so that equal
+ * strings in the same encoding share a `CHARSXP` pointer. The index
+ * hashes these pointers. Non-ASCII strings that are not marked as
+ * UTF-8 are also indexed by their UTF-8 translation so that lookups
+ * don't depend on the encoding of the needle.
+ *
+ * The index must be protected through its `shelter`. It doesn't
+ * follow modifications of the character vector.
+ */
+struct r_chr_index {
+  sexp* shelter;
+
+  // private:
+  struct r_chr_index_slot* p_slots;
+  r_ssize n_slots;
+};
+
+struct r_chr_index* r_new_chr_index(sexp* chr);
+
+// Returns the position of the first occurrence of `str` or -1
+r_ssize r_chr_index_get(struct r_chr_index* p_index, sexp* str);
+r_ssize r_chr_index_get_c_string(struct r_chr_index* p_index, const char* c_string);
+
+static inline
+bool r_chr_index_has(struct r_chr_index* p_index, sexp* str) {
+  return r_chr_index_get(p_index, str) >= 0;
+}
+
+// Linear search with the same matching rules as `r_chr_index_get()`,
+// for vectors too short to be worth indexing
+r_ssize r_chr_find(sexp* chr, sexp* str);
+
+
 static inline
 sexp* r_str_as_character(sexp* x) {
   return Rf_ScalarString(x);
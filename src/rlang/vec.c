@@ -167,39 +167,21 @@ void r_vec_poke_n(sexp* x, r_ssize offset,
   }
 
   switch (r_typeof(x)) {
-  case r_type_logical: {
-    int* src_data = r_lgl_deref(y);
-    int* dest_data = r_lgl_deref(x);
-    for (r_ssize i = 0; i != n; ++i)
-      dest_data[i + offset] = src_data[i + from];
-    break;
-  }
-  case r_type_integer: {
-    int* src_data = r_int_deref(y);
-    int* dest_data = r_int_deref(x);
-    for (r_ssize i = 0; i != n; ++i)
-      dest_data[i + offset] = src_data[i + from];
-    break;
-  }
-  case r_type_double: {
-    double* src_data = r_dbl_deref(y);
-    double* dest_data = r_dbl_deref(x);
-    for (r_ssize i = 0; i != n; ++i)
-      dest_data[i + offset] = src_data[i + from];
-    break;
-  }
-  case r_type_complex: {
-    r_complex_t* src_data = r_cpl_deref(y);
-    r_complex_t* dest_data = r_cpl_deref(x);
-    for (r_ssize i = 0; i != n; ++i)
-      dest_data[i + offset] = src_data[i + from];
-    break;
-  }
-  case RAWSXP: {
-    unsigned char* src_data = RAW(y);
-    unsigned char* dest_data = RAW(x);
-    for (r_ssize i = 0; i != n; ++i)
-      dest_data[i + offset] = src_data[i + from];
+  case r_type_logical:
+  case r_type_integer:
+  case r_type_double:
+  case r_type_complex:
+  case r_type_raw: {
+    enum r_type y_type = r_typeof(y);
+    if (y_type != r_typeof(x) && !(y_type == r_type_logical && r_typeof(x) == r_type_integer)) {
+      r_abort("Can't copy data from `y` because it has a different type");
+    }
+
+    // Payloads without write barrier are copied in bulk
+    r_ssize elt_size = r_vec_elt_sizeof(x);
+    const unsigned char* src_data = r_vec_deref_const(y);
+    unsigned char* dest_data = r_vec_deref(x);
+    memcpy(dest_data + offset * elt_size, src_data + from * elt_size, n * elt_size);
     break;
   }
   case r_type_character: {